@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Seconds between the keys of a recorded path
+const double cameraPathKeyInterval = 0.5;
+
+// Camera position and angles (in degrees) at a time along a path
+struct CameraKey
+{
+	float time;
+	glm::vec3 position;
+	float yaw;
+	float pitch;
+};
+
+/*
+Path the camera follows in benchmark mode, a Catmull-Rom spline through keys ordered by time. Paths are either the
+scripted default or recorded from a flight with --record, and are stored as text with one key per line:
+time x y z yaw pitch.
+*/
+class CameraPath
+{
+public:
+	/*
+	Default path, a fast low flight that turns back over itself, climbs to see the far levels of detail and dives back
+	down, so it exercises streaming, LOD transitions and both kinds of culling
+	*/
+	static CameraPath scripted()
+	{
+		CameraPath path;
+		path.keys = {
+			{ 0.0f, { 255.5f, 10.0f, 255.5f }, 0.0f, 0.0f },
+			{ 5.0f, { 755.5f, 20.0f, 255.5f }, 0.0f, -5.0f },
+			{ 10.0f, { 1255.5f, 15.0f, 455.5f }, 45.0f, 0.0f },
+			{ 15.0f, { 1455.5f, 30.0f, 955.5f }, 135.0f, -10.0f },
+			{ 20.0f, { 1055.5f, 120.0f, 1255.5f }, 180.0f, -20.0f },
+			{ 25.0f, { 455.5f, 300.0f, 1255.5f }, 200.0f, -30.0f },
+			{ 30.0f, { -144.5f, 60.0f, 855.5f }, 250.0f, -10.0f },
+			{ 35.0f, { -344.5f, 5.0f, 255.5f }, 300.0f, 5.0f },
+			{ 40.0f, { 255.5f, 10.0f, 255.5f }, 360.0f, 0.0f },
+		};
+		return path;
+	}
+
+	bool load(const std::string &path)
+	{
+		std::ifstream file(path);
+		if (!file) return false;
+		keys.clear();
+		CameraKey key;
+		while (file >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch) keys.push_back(key);
+		return keys.size() >= 2;
+	}
+
+	bool save(const std::string &path) const
+	{
+		std::ofstream file(path);
+		for (const CameraKey &key : keys)
+		{
+			file << key.time << ' ' << key.position.x << ' ' << key.position.y << ' ' << key.position.z << ' ' << key.yaw << ' ' << key.pitch << '\n';
+		}
+		return (bool)file;
+	}
+
+	// Adds a key after the last one
+	void add(const CameraKey &key)
+	{
+		keys.push_back(key);
+	}
+
+	// Time of the last key
+	double duration() const
+	{
+		return keys.empty() ? 0.0 : keys.back().time;
+	}
+
+	// Camera at time along the path, times past the end wrap around to the start
+	CameraKey sample(double time) const
+	{
+		if (keys.size() < 2) return keys.empty() ? CameraKey{} : keys[0];
+		time = std::fmod(time, duration());
+
+		size_t segment = 0;
+		while (segment + 2 < keys.size() && keys[segment + 1].time <= time) segment++;
+		const CameraKey &a = keys[segment > 0 ? segment - 1 : 0];
+		const CameraKey &b = keys[segment];
+		const CameraKey &c = keys[segment + 1];
+		const CameraKey &d = keys[segment + 2 < keys.size() ? segment + 2 : segment + 1];
+		float t = (float)((time - b.time) / (c.time - b.time));
+
+		CameraKey key;
+		key.time = (float)time;
+		key.position = catmullRom(a.position, b.position, c.position, d.position, t);
+		key.yaw = catmullRom(a.yaw, b.yaw, c.yaw, d.yaw, t);
+		key.pitch = catmullRom(a.pitch, b.pitch, c.pitch, d.pitch, t);
+		return key;
+	}
+
+private:
+	// Uniform Catmull-Rom interpolation between b and c, which passes through every key
+	template <typename T>
+	static T catmullRom(const T &a, const T &b, const T &c, const T &d, float t)
+	{
+		float t2 = t * t;
+		float t3 = t2 * t;
+		return 0.5f * ((2.0f * b) + (c - a) * t + (2.0f * a - 5.0f * b + 4.0f * c - d) * t2 + (3.0f * b - a - 3.0f * c + d) * t3);
+	}
+
+	std::vector<CameraKey> keys;
+};
@@ -0,0 +1,1173 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "erosion.h"
+#include "frame_arena.h"
+#include "fractal_noise.h"
+#include "gpu_generator.h"
+#include "mpsc_queue.h"
+#include "profiler.h"
+#include "staging_pool.h"
+#include "thread_pool.h"
+#include "tile_cache.h"
+#include "uniform_buffer.h"
+#include "world_position.h"
+
+// Number of squares along each side of a chunk
+const int chunkSize = 64;
+
+// Number of vertices along each side of a chunk (edge vertices are duplicated between neighbours)
+const int chunkVertexSize = chunkSize + 1;
+const int chunkVertexCount = chunkVertexSize * chunkVertexSize;
+
+/*
+Chunks exist at several levels of detail. A chunk of level l has as many vertices as a level 0 chunk but spaced
+2^l apart, so it covers the area of four chunks of level l - 1 which are its children in a quadtree.
+*/
+const int lodLevelCount = 5;
+
+// Chunks of level l are drawn up to lodRange times their width away from the camera (along the xz plane)
+const float lodRange = 3.0f;
+
+/*
+Vertices of level l blend into level l + 1 between these fractions of the level's range. The blend finishes short
+of the range so vertices on the border with a coarser chunk are always fully blended, and starts far enough out
+that the coarser chunk itself hasn't started blending there.
+*/
+const float morphStart = 0.8f;
+const float morphEnd = 0.95f;
+
+// Each level stores its chunks in a square ring buffer of slots wide enough to hold every chunk in its range
+const int ringSize = 7;
+const int levelSlotCount = ringSize * ringSize;
+const int slotCount = lodLevelCount * levelSlotCount;
+
+/*
+Chunk indices are 16 bit whenever a chunk has few enough vertices (up to 255 squares along each side), the largest
+value is reserved to restart triangle strips.
+*/
+typedef std::conditional<chunkVertexCount < 0xFFFF, uint16_t, uint32_t>::type ChunkIndex;
+const ChunkIndex stripRestartIndex = (ChunkIndex)~(ChunkIndex)0;
+const GLenum chunkIndexType = sizeof(ChunkIndex) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+/*
+Triangle strips run along x for this many squares so neighbouring strips share vertices while they are still in
+the post-transform cache, short enough to suit caches of only 16 vertices
+*/
+const int stripLength = 6;
+
+/*
+Everything the terrain shaders read that changes from frame to frame, laid out as the std140 Frame block of
+vertex_shader.txt. Each level's values are padded to a vec4 as std140 arrays are.
+*/
+struct FrameUniforms
+{
+	glm::mat4 projectionMatrix;
+	glm::vec4 heightRange; // Lowest and highest height the vertex heights are normalised over, in x and y
+	glm::vec4 levels[lodLevelCount]; // Position relative to the camera of the level's window of chunks in xy, morph range in zw
+	glm::ivec4 ringStartSlots[lodLevelCount]; // Slot of the window's first chunk in the level's ring buffer, in xy
+};
+
+static_assert(sizeof(FrameUniforms) == 64 + 16 + 32 * lodLevelCount, "FrameUniforms must match the std140 layout of the Frame block");
+
+/*
+Number of chunks that can be generating or waiting to be uploaded at once, each owning a staging buffer. Limits how
+far a large jump can queue work ahead of the closest chunks.
+*/
+const int chunkBufferCount = 32;
+
+// Limits the number of chunks the compute shader generates in one frame
+const int maxGpuChunksPerFrame = 16;
+
+/*
+Largest differences from chunks generated on the CPU that chunks generated by the compute shader may have, in world
+units of height and steps of the 8 bit normals. GPUs are free to evaluate the noise's float arithmetic differently,
+so only the CPU paths are expected to match exactly.
+*/
+const float gpuHeightTolerance = 0.02f;
+const int gpuNormalTolerance = 2;
+
+/*
+Bytes of vertex data copied into the vertex buffer per frame, from finished chunks and the tile cache, so streaming
+terrain in never makes one frame much longer than the rest
+*/
+const size_t uploadBudgetBytes = 256 * 1024;
+
+// Chunks are split into tiles of this many rows which are generated in parallel, must be even
+const int tileRows = 8;
+const int tilesPerChunk = (chunkVertexSize + tileRows - 1) / tileRows;
+
+// Chunks that are eroded are split into larger tiles so less of the work is spent on halos, must be a multiple of tileRows
+const int erosionTileRows = 3 * tileRows;
+
+// Changing the vertex layout invalidates every cached chunk
+const uint64_t chunkFormatVersion = 4;
+
+/*
+Vertex of a chunk. Only the heights are stored, quantised to 16 bits over the range of the noise, the x and z of
+the vertex are found in the vertex shader from its position in the vertex buffer. Normals are stored as the x and
+z of the unit normal in 8 bits each, the y is always positive so the vertex shader recovers it from them.
+*/
+struct Vertex
+{
+	uint16_t height;
+	uint16_t morphHeight; // Height the vertex moves to as it blends into the next level
+	int8_t normal[2];
+	int8_t morphNormal[2]; // Normal of the next level's surface at the vertex
+};
+
+const size_t chunkBytes = chunkVertexCount * sizeof(Vertex);
+
+// Chunk (x, z) of a level of detail, x and z are the world position divided by the chunk's width
+struct ChunkCoordinate
+{
+	int level;
+	int64_t x, z;
+};
+
+// Chunk being generated by the thread pool, queued for upload by the worker that finishes its last tile
+struct PendingChunk : MpscNode
+{
+	int level;
+	int64_t x, z;
+	bool inFlight = false; // Generating or waiting to be uploaded
+	std::atomic<int> tilesRemaining{ 0 };
+	Vertex *out = NULL; // Where the chunk is generated, in its mapped staging buffer
+	Vertex *cacheOut = NULL; // Reserved slot of the tile cache the chunk is also written to, or NULL
+
+	// Lowest and highest heights (including the heights blended towards) found by each tile
+	float tileMinimum[tilesPerChunk];
+	float tileMaximum[tilesPerChunk];
+};
+
+// Slot in the ring buffer holding the vertices of one chunk
+struct ChunkSlot
+{
+	int64_t x, z; // Chunk coordinates of the chunk held in the slot
+	bool loaded;
+	float minimumHeight, maximumHeight; // Bounds of every height the chunk can be drawn at
+};
+
+// Running totals of the work done by a ChunkManager, used to compare benchmark runs
+struct ChunkStatistics
+{
+	uint64_t chunksGenerated = 0;
+	uint64_t chunksFromCache = 0;
+	uint64_t bytesUploaded = 0; // Copied into the vertex buffer from the CPU, chunks generated on the GPU aren't counted
+	uint64_t trianglesDrawn = 0;
+};
+
+/*
+Memory a ChunkManager owns, all of it allocated by initialise. Loading and unloading chunks reuses it rather than
+allocating, so this is the most the terrain ever uses outside the tile cache.
+*/
+struct ChunkMemory
+{
+	size_t vertexBuffer = 0; // Ring buffers of every level on the GPU
+	size_t indexBuffer = 0;
+	size_t staging = 0; // Staging buffers chunks are generated into
+	size_t scratch = 0; // Per frame lists of chunks to load, scratchPeak of it has been used
+	size_t scratchPeak = 0;
+};
+
+// Largest differences found by ChunkManager::compareGpuGeneration between chunks generated by the compute shader and on the CPU
+struct GpuComparison
+{
+	int chunks = 0;
+	float heightDifference = 0.0f; // World units
+	int normalDifference = 0; // Steps of the 8 bit normals
+
+	bool passed() const
+	{
+		return heightDifference <= gpuHeightTolerance && normalDifference <= gpuNormalTolerance;
+	}
+};
+
+/*
+Generates, caches and draws chunks around the camera at several levels of detail.
+Every level keeps a 2D ring buffer of slots in a single vertex buffer: chunk (x, z) of level l is always stored in
+slot (x mod ringSize, z mod ringSize) of the level. As the camera moves only chunks newly in range map onto slots
+holding stale chunks, so only those are generated and copied over the old ones on the GPU. Because a
+level's range grows with its chunk width every level holds the same number of chunks, so the view distance doubles
+with each level while the number of vertices generated and drawn grows linearly.
+
+Drawing walks the quadtree from the coarsest level down, splitting a chunk into its children where they are in
+range. Each quadrant of the shared index buffer is contiguous, so where only some children are in range the
+remaining quadrants of the parent are drawn instead. To avoid cracks and popping every vertex also stores the
+height of the coarser level's surface at its position, which the vertex shader blends towards with distance so
+that a chunk matches its coarser neighbours exactly where they meet.
+
+Chunks, or quadrants of chunks, that would be drawn are culled against the view frustum and then, front to back,
+against the horizon formed by the chunks in front of them using the height bounds recorded when they were made.
+*/
+class ChunkManager
+{
+public:
+	~ChunkManager()
+	{
+		// Tasks still running write into this object's staging memory
+		if (threadPool) threadPool->wait(generation);
+
+		// Keeps finished chunks that were never uploaded rather than leaving their cache slots reserved
+		for (const PendingChunk &chunk : pending)
+		{
+			if (chunk.inFlight && chunk.cacheOut) tileCache->commit(chunk.x, chunk.z, levelHash[chunk.level]);
+		}
+	}
+
+	void initialise(ThreadPool &pool, const FractalNoise &noise)
+	{
+		threadPool = &pool;
+
+		// Every level's heights lie within the range of the full noise
+		heightMinimum = noise.minimumHeight();
+		heightRange = noise.maximumHeight() - noise.minimumHeight();
+
+		// Octaves finer than a level's vertices can't be represented by it so aren't evaluated
+		for (int level = 0; level < lodLevelCount; level++)
+		{
+			levelNoise[level] = noise.withoutOctavesFinerThan(2.0f * levelSpacing(level));
+		}
+
+		// Every chunk has the same layout so a single element buffer is shared between them, ordered by quadrant
+		std::vector<ChunkIndex> indices = buildChunkIndices();
+		quadrantIndexCount = indices.size() / 4;
+		indexCount = indices.size();
+
+		// The element buffer binding belongs to the vertex array, so it is bound first to capture the binding
+		glGenVertexArrays(1, &vertexArray);
+		glBindVertexArray(vertexArray);
+
+		glGenBuffers(1, &elementBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(ChunkIndex), &indices[0], GL_STATIC_DRAW);
+
+		// Allocates the ring buffers once, chunks are written into them as they are generated
+		glGenBuffers(1, &vertexBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, slotCount * chunkBytes, NULL, GL_DYNAMIC_DRAW);
+
+		// Both heights are read as one normalised attribute, and both normals as another
+		glVertexAttribPointer(0, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Vertex), 0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 4, GL_BYTE, GL_TRUE, sizeof(Vertex), (const void *)offsetof(Vertex, normal));
+		glEnableVertexAttribArray(1);
+
+		// Nothing else draws strips, so restarting them is left enabled rather than set every frame
+		glEnable(GL_PRIMITIVE_RESTART);
+		glPrimitiveRestartIndex(stripRestartIndex);
+
+		for (ChunkSlot &slot : slots) slot = { 0, 0, false, 0.0f, 0.0f };
+
+		// Every pending chunk is generated into its own staging buffer
+		staging.initialise(chunkBytes, chunkBufferCount);
+
+		// At most every slot can be missing its chunk, update lists them once and again without the cached ones
+		scratch.initialise(2 * (slotCount * sizeof(ChunkCoordinate) + arenaAlignment));
+
+		// Each of a slot's quadrants can be selected at most once a frame, so the lists never grow after this
+		selected.reserve(4 * slotCount);
+		visible.reserve(4 * slotCount);
+		drawList.commands.reserve(4 * slotCount);
+		drawList.counts.reserve(4 * slotCount);
+		drawList.offsets.reserve(4 * slotCount);
+		drawList.baseVertices.reserve(4 * slotCount);
+
+		// The draw commands are read from a buffer when the context can, so one call draws every chunk
+		indirect = GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_multi_draw_indirect;
+		if (indirect)
+		{
+			glGenBuffers(1, &indirectBuffer);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, 4 * slotCount * sizeof(DrawCommand), NULL, GL_STREAM_DRAW);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		}
+	}
+
+	// Keeps generated chunks in cache and reuses them instead of generating them again
+	void setTileCache(TileCache *cache)
+	{
+		tileCache = cache;
+		updateLevelHashes();
+	}
+
+	/*
+	Erodes the chunks of the finest level after generating them, which is only done on the thread pool. Eroded
+	chunks are cached like any other so each is only eroded once.
+	*/
+	void setErosion(const ThermalErosion &settings)
+	{
+		erosion = settings;
+		erosion.iterations = std::min(erosion.iterations, maxErosionIterations);
+		updateLevelHashes();
+	}
+
+	// Generates chunks with the compute shader instead of the thread pool
+	void setGpuGenerator(GpuTerrainGenerator *generator)
+	{
+		gpuGenerator = generator;
+	}
+
+	// Times noise evaluation and uploads with profiler
+	void setProfiler(Profiler *profiler)
+	{
+		this->profiler = profiler;
+	}
+
+	/*
+	Makes each update wait for the chunks it queues and upload all of them, so the chunks drawn each frame only
+	depend on the camera and never on how long generation took. Used by benchmark mode.
+	*/
+	void setSynchronous(bool synchronous)
+	{
+		this->synchronous = synchronous;
+	}
+
+	/*
+	Generates chunks of every level with the compute shader into a buffer of their own and on the CPU as the thread
+	pool would, and compares their vertices, blended heights and normals included. The chunks are around the
+	origin and far from it, where the origin is split across the CPU and GPU. Needs a GPU generator.
+	*/
+	GpuComparison compareGpuGeneration()
+	{
+		GpuComparison comparison;
+		if (!gpuGenerator) return comparison;
+
+		unsigned int buffer;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, chunkBytes, NULL, GL_DYNAMIC_READ);
+
+		std::vector<Vertex> cpuVertices(chunkVertexCount);
+		std::vector<Vertex> gpuVertices(chunkVertexCount);
+		const int64_t farChunk = (int64_t)1 << 24;
+		const int64_t chunks[][2] = { { 0, 0 }, { -3, 2 }, { farChunk, -farChunk } };
+		for (int level = 0; level < lodLevelCount; level++)
+		{
+			for (const int64_t *coordinate : chunks)
+			{
+				PendingChunk chunk;
+				chunk.level = level;
+				chunk.x = coordinate[0];
+				chunk.z = coordinate[1];
+				chunk.out = cpuVertices.data();
+				for (int row = 0; row < chunkVertexSize; row += tileRows) generateRows(chunk, row, std::min(row + tileRows, chunkVertexSize));
+
+				int64_t width = chunkSize << level;
+				const FractalNoise *coarser = level + 1 < lodLevelCount ? &levelNoise[level + 1] : NULL;
+				gpuGenerator->generate(buffer, 0, { chunk.x * width, chunk.z * width }, levelSpacing(level), chunkVertexSize, levelNoise[level], coarser, heightMinimum, heightRange);
+				glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+				glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, chunkBytes, gpuVertices.data());
+
+				for (int i = 0; i < chunkVertexCount; i++)
+				{
+					const Vertex &expected = cpuVertices[i];
+					const Vertex &vertex = gpuVertices[i];
+					comparison.heightDifference = std::max(comparison.heightDifference, std::fabs(dequantise(vertex.height) - dequantise(expected.height)));
+					comparison.heightDifference = std::max(comparison.heightDifference, std::fabs(dequantise(vertex.morphHeight) - dequantise(expected.morphHeight)));
+					for (int k = 0; k < 2; k++)
+					{
+						comparison.normalDifference = std::max(comparison.normalDifference, std::abs(vertex.normal[k] - expected.normal[k]));
+						comparison.normalDifference = std::max(comparison.normalDifference, std::abs(vertex.morphNormal[k] - expected.morphNormal[k]));
+					}
+				}
+				comparison.chunks++;
+			}
+		}
+		glDeleteBuffers(1, &buffer);
+		return comparison;
+	}
+
+	const ChunkStatistics &statistics() const
+	{
+		return totals;
+	}
+
+	ChunkMemory memoryUsage() const
+	{
+		ChunkMemory memory;
+		memory.vertexBuffer = slotCount * chunkBytes;
+		memory.indexBuffer = indexCount * sizeof(ChunkIndex);
+		memory.staging = chunkBufferCount * chunkBytes;
+		memory.scratch = scratch.capacity();
+		memory.scratchPeak = scratch.peak();
+		return memory;
+	}
+
+	/*
+	Generates chunks that have come into range of position over the slots of chunks that have left it, coarsest
+	level first so there are never holes in the distance. The render thread never waits on generation: chunks are
+	generated on the thread pool, which hands each one back through a lock-free queue as soon as it is finished, and
+	each frame only uploads up to uploadBudgetBytes of finished or cached chunks, unless synchronous is set, when it
+	waits for the chunks it queued and uploads every one of them. With generate false the chunks already finished are
+	uploaded but no new ones are queued, which limits how often the world is searched for missing chunks. Returns
+	true if it ran the compute shader, which leaves its program in use.
+	*/
+	bool update(const WorldPosition &position, bool generate = true)
+	{
+		camera = position;
+
+		size_t budget = uploadBudgetBytes;
+		uploadFinished(budget);
+		if (!generate) return false;
+
+		// Finds chunks in range whose slot still holds a stale chunk and which aren't already being generated
+		scratch.reset();
+		ChunkCoordinate *missing = scratch.allocate<ChunkCoordinate>(slotCount);
+		size_t missingCount = 0;
+		for (int level = 0; level < lodLevelCount; level++)
+		{
+			int64_t xStart, xEnd, zStart, zEnd;
+			levelWindow(level, xStart, xEnd, zStart, zEnd);
+			for (int64_t x = xStart; x <= xEnd; x++)
+			{
+				for (int64_t z = zStart; z <= zEnd; z++)
+				{
+					if (!inRange(level, x, z) || isLoaded(level, x, z)) continue;
+					if (!isPending(level, x, z)) missing[missingCount++] = { level, x, z };
+				}
+			}
+		}
+
+		// Generates the coarsest levels first, then the closest chunks of each level
+		std::sort(missing, missing + missingCount, [this](const ChunkCoordinate &a, const ChunkCoordinate &b)
+		{
+			if (a.level != b.level) return a.level > b.level;
+			return chunkDistance(a.level, a.x, a.z) < chunkDistance(b.level, b.x, b.z);
+		});
+
+		// Uploads cached chunks straight out of the mapped file with what's left of the budget, the GPU path is fast
+		// enough not to need the cache. Cached chunks that don't fit the budget wait for the next frame rather than
+		// being generated again over their cached copy.
+		if (tileCache && !gpuGenerator)
+		{
+			ScopedTimer timer(profiler, profileUpload);
+			glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+			ChunkCoordinate *uncached = scratch.allocate<ChunkCoordinate>(slotCount);
+			size_t uncachedCount = 0;
+			for (size_t i = 0; i < missingCount; i++)
+			{
+				const ChunkCoordinate &coordinate = missing[i];
+				const void *cached = tileCache->find(coordinate.x, coordinate.z, levelHash[coordinate.level]);
+				if (!cached)
+				{
+					uncached[uncachedCount++] = coordinate;
+					continue;
+				}
+				if (budget < chunkBytes) continue;
+				int slot = slotIndex(coordinate.level, coordinate.x, coordinate.z);
+				glBufferSubData(GL_ARRAY_BUFFER, slot * chunkBytes, chunkBytes, cached);
+				float minimum, maximum;
+				heightBounds((const Vertex *)cached, minimum, maximum);
+				slots[slot] = { coordinate.x, coordinate.z, true, minimum, maximum };
+				budget -= chunkBytes;
+				totals.chunksFromCache++;
+				totals.bytesUploaded += chunkBytes;
+			}
+			missing = uncached;
+			missingCount = uncachedCount;
+		}
+
+		// The compute shader writes straight into the slots so the chunks can be drawn this frame
+		if (gpuGenerator)
+		{
+			missingCount = std::min<size_t>(missingCount, maxGpuChunksPerFrame);
+			for (size_t i = 0; i < missingCount; i++)
+			{
+				const ChunkCoordinate &coordinate = missing[i];
+				int slot = slotIndex(coordinate.level, coordinate.x, coordinate.z);
+				int64_t width = chunkSize << coordinate.level;
+				const FractalNoise *coarser = coordinate.level + 1 < lodLevelCount ? &levelNoise[coordinate.level + 1] : NULL;
+				gpuGenerator->generate(vertexBuffer, slot * chunkVertexCount, { coordinate.x * width, coordinate.z * width }, levelSpacing(coordinate.level),
+					chunkVertexSize, levelNoise[coordinate.level], coarser, heightMinimum, heightRange);
+
+				// The heights stay on the GPU so the chunk is bounded by everything its noise can produce
+				const FractalNoise &noise = levelNoise[coordinate.level];
+				const FractalNoise &blended = morphNoise(coordinate.level);
+				float minimum = std::min(noise.minimumHeight(), blended.minimumHeight());
+				float maximum = std::max(noise.maximumHeight(), blended.maximumHeight());
+				slots[slot] = { coordinate.x, coordinate.z, true, minimum, maximum };
+				totals.chunksGenerated++;
+			}
+			if (missingCount > 0) gpuGenerator->finish();
+			return missingCount > 0;
+		}
+
+		// Queues every tile of as many missing chunks as there are free staging buffers, so the workers can balance
+		// them between themselves, stopping early if the GPU is still copying out of the rest
+		for (size_t i = 0; i < missingCount; i++)
+		{
+			const ChunkCoordinate &coordinate = missing[i];
+			int buffer = staging.acquire();
+			if (buffer < 0) break;
+
+			PendingChunk *chunk = &pending[buffer];
+			chunk->level = coordinate.level;
+			chunk->x = coordinate.x;
+			chunk->z = coordinate.z;
+			chunk->inFlight = true;
+			int rowsPerTask = erodes(chunk->level) ? erosionTileRows : tileRows;
+			chunk->tilesRemaining.store((chunkVertexSize + rowsPerTask - 1) / rowsPerTask, std::memory_order_relaxed);
+			chunk->out = (Vertex *)staging.data(buffer);
+
+			// Also writes the chunk into the tile cache when it has room
+			chunk->cacheOut = tileCache ? (Vertex *)tileCache->reserve(chunk->x, chunk->z, levelHash[chunk->level]) : NULL;
+
+			// Tasks only capture what fits in std::function without allocating
+			for (int row = 0; row < chunkVertexSize; row += rowsPerTask)
+			{
+				threadPool->submit(generation, [this, buffer, row]
+				{
+					PendingChunk *chunk = &pending[buffer];
+					if (erodes(chunk->level)) generateErodedRows(*chunk, row, std::min(row + erosionTileRows, chunkVertexSize));
+					else generateRows(*chunk, row, std::min(row + tileRows, chunkVertexSize));
+					if (chunk->tilesRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1) finished.push(chunk);
+				});
+			}
+		}
+
+		// Waits for the GPU too so the copies' fences are signalled and every staging buffer is free next frame
+		if (synchronous)
+		{
+			threadPool->wait(generation);
+			size_t unlimited = SIZE_MAX;
+			uploadFinished(unlimited);
+			glFinish();
+		}
+		return false;
+	}
+
+	/*
+	Selects the chunks to draw around the camera, culls those outside the view of projectionMatrix or hidden
+	behind terrain, and draws every chunk of every level with a single draw call, front to back. Everything is
+	placed relative to the camera along x and z, so projectionMatrix must view from (0, y, 0) rather than the
+	camera's world position. The frame's uniforms are written to uniforms, which is only uploaded if they changed.
+	*/
+	void draw(UniformBuffer<FrameUniforms> &uniforms, const glm::mat4 &projectionMatrix)
+	{
+		drawList.commands.clear();
+		drawList.counts.clear();
+		drawList.offsets.clear();
+		drawList.baseVertices.clear();
+		selected.clear();
+
+		const int top = lodLevelCount - 1;
+		int64_t xStart, xEnd, zStart, zEnd;
+		levelWindow(top, xStart, xEnd, zStart, zEnd);
+		for (int64_t x = xStart; x <= xEnd; x++)
+		{
+			for (int64_t z = zStart; z <= zEnd; z++)
+			{
+				if (inRange(top, x, z) && isLoaded(top, x, z)) selectChunk(top, x, z);
+			}
+		}
+
+		// Culls against the frustum first as it is cheaper, then against the horizon from front to back
+		Frustum frustum(projectionMatrix);
+		visible.clear();
+		for (const SelectedChunk &chunk : selected)
+		{
+			if (frustum.intersects(chunk.bounds)) visible.push_back(chunk);
+		}
+		std::sort(visible.begin(), visible.end(), [](const SelectedChunk &a, const SelectedChunk &b) { return a.distance < b.distance; });
+
+		horizonCuller.begin(glm::vec3(0.0f, camera.local.y, 0.0f));
+		for (const SelectedChunk &chunk : visible)
+		{
+			if (horizonCuller.hidden(chunk.bounds)) continue;
+			horizonCuller.addOccluder(chunk.bounds);
+			addDraw(chunk.slot, chunk.quadrant);
+		}
+
+		/*
+		A chunk's level and place in its ring are found by the vertex shader from the slot its base vertex is in, so
+		only each level's window of chunks in range is needed and the chunks need no parameters of their own. Every
+		chunk in range lies in the window, so the shader can place a slot's chunk from the window's first chunk.
+		*/
+		FrameUniforms &frame = uniforms.data();
+		frame.projectionMatrix = projectionMatrix;
+		frame.heightRange = glm::vec4(heightMinimum, heightMinimum + heightRange, 0.0f, 0.0f);
+		for (int level = 0; level < lodLevelCount; level++)
+		{
+			int64_t xStart, xEnd, zStart, zEnd;
+			levelWindow(level, xStart, xEnd, zStart, zEnd);
+			int64_t width = chunkSize << level;
+			frame.levels[level] = glm::vec4(camera.relativeX(xStart * width), camera.relativeZ(zStart * width), morphStart * levelRange(level), morphEnd * levelRange(level));
+			frame.ringStartSlots[level] = glm::ivec4((int)(((xStart % ringSize) + ringSize) % ringSize), (int)(((zStart % ringSize) + ringSize) % ringSize), 0, 0);
+		}
+		uniforms.commit();
+
+		glBindVertexArray(vertexArray);
+		if (drawList.commands.empty()) return;
+
+		if (indirect)
+		{
+			// Orphans last frame's commands, which the GPU may still be reading
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, 4 * slotCount * sizeof(DrawCommand), NULL, GL_STREAM_DRAW);
+			glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, drawList.commands.size() * sizeof(DrawCommand), &drawList.commands[0]);
+			glMultiDrawElementsIndirect(GL_TRIANGLE_STRIP, chunkIndexType, NULL, (GLsizei)drawList.commands.size(), 0);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		}
+		else
+		{
+			glMultiDrawElementsBaseVertex(GL_TRIANGLE_STRIP, &drawList.counts[0], chunkIndexType, &drawList.offsets[0], (GLsizei)drawList.counts.size(), &drawList.baseVertices[0]);
+		}
+	}
+
+private:
+	// Layout glMultiDrawElementsIndirect reads each draw from
+	struct DrawCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	/*
+	Draw parameters of every chunk drawn this frame, kept between frames to avoid reallocating. The commands are
+	used with indirect drawing, the separate arrays by glMultiDrawElementsBaseVertex otherwise.
+	*/
+	struct DrawList
+	{
+		std::vector<DrawCommand> commands;
+		std::vector<GLsizei> counts;
+		std::vector<const void *> offsets;
+		std::vector<GLint> baseVertices;
+	};
+
+	/*
+	Builds the indices of a chunk as triangle strips, each quadrant's indices being contiguous so it can be drawn by
+	itself. A quadrant is split into bands of stripLength squares along x, and each band into strips one square wide
+	that run along x, separated by the restart index. Each strip of a band reuses the vertices along one side of the
+	previous strip, which keeps them in the post-transform cache.
+	Square of v----v
+			  |   /|
+			  |  / |
+			  | /  |
+			  v----v
+	The strip visits (i, j), (i, j + 1), (i + 1, j), (i + 1, j + 1), (i + 2, j)... so each square is split along
+	the same diagonal, from (i, j + 1) to (i + 1, j), and wound the same way as two separate triangles
+	(i, j), (i, j + 1), (i + 1, j) and (i + 1, j), (i, j + 1), (i + 1, j + 1).
+	*/
+	static std::vector<ChunkIndex> buildChunkIndices()
+	{
+		const int half = chunkSize / 2;
+		const int bandsPerQuadrant = (half + stripLength - 1) / stripLength;
+		std::vector<ChunkIndex> indices;
+		indices.reserve(4 * bandsPerQuadrant * half * (2 * (stripLength + 1) + 1));
+		for (int quadrant = 0; quadrant < 4; quadrant++)
+		{
+			int iStart = (quadrant / 2) * half;
+			int jStart = (quadrant % 2) * half;
+			for (int bandStart = iStart; bandStart < iStart + half; bandStart += stripLength)
+			{
+				int bandEnd = std::min(bandStart + stripLength, iStart + half);
+				for (int j = jStart; j < jStart + half; j++)
+				{
+					for (int i = bandStart; i <= bandEnd; i++)
+					{
+						indices.push_back((ChunkIndex)(chunkVertexSize * i + j));
+						indices.push_back((ChunkIndex)(chunkVertexSize * i + j + 1));
+					}
+					indices.push_back(stripRestartIndex);
+				}
+			}
+		}
+		return indices;
+	}
+
+	// Chunk, or quadrant of a chunk, chosen to be drawn before culling
+	struct SelectedChunk
+	{
+		int level, slot, quadrant;
+		BoundingBox bounds; // Relative to the camera along x and z
+		float distance; // Distance along the xz plane from the camera
+	};
+
+	// Quadrant value meaning the whole chunk
+	static const int allQuadrants = 4;
+
+	// Distance between neighbouring vertices of a level
+	static int levelSpacing(int level)
+	{
+		return 1 << level;
+	}
+
+	// Distance from the camera within which a level's chunks are drawn
+	static float levelRange(int level)
+	{
+		return lodRange * (chunkSize << level);
+	}
+
+	// Slot of the ring buffer that chunk (x, z) of level is stored in
+	static int slotIndex(int level, int64_t x, int64_t z)
+	{
+		int slotX = (int)(((x % ringSize) + ringSize) % ringSize);
+		int slotZ = (int)(((z % ringSize) + ringSize) % ringSize);
+		return level * levelSlotCount + slotX * ringSize + slotZ;
+	}
+
+	// Whether chunks of level are eroded, only the finest level has the detail for it to matter
+	bool erodes(int level) const
+	{
+		return level == 0 && erosion.enabled();
+	}
+
+	// Chunks of different levels, or cached with different noise or erosion, are told apart by their hash
+	void updateLevelHashes()
+	{
+		for (int level = 0; level < lodLevelCount; level++)
+		{
+			uint64_t hash = levelNoise[level].hash() * 31 + morphNoise(level).hash();
+			if (erodes(level)) hash = hash * 31 + erosion.hash();
+			levelHash[level] = hash ^ (chunkFormatVersion << 56) ^ ((uint64_t)level << 48) ^ ((uint64_t)chunkSize << 32) ^ sizeof(Vertex);
+		}
+	}
+
+	// Noise of the level a chunk blends into, the coarsest level doesn't blend
+	const FractalNoise &morphNoise(int level) const
+	{
+		return levelNoise[std::min(level + 1, lodLevelCount - 1)];
+	}
+
+	// Distance along the xz plane from the camera to the closest point of chunk (x, z) of level
+	float chunkDistance(int level, int64_t x, int64_t z) const
+	{
+		int64_t width = chunkSize << level;
+		float xDistance = std::max(std::max(camera.relativeX(x * width), -camera.relativeX((x + 1) * width)), 0.0f);
+		float zDistance = std::max(std::max(camera.relativeZ(z * width), -camera.relativeZ((z + 1) * width)), 0.0f);
+		return std::sqrt(xDistance * xDistance + zDistance * zDistance);
+	}
+
+	bool inRange(int level, int64_t x, int64_t z) const
+	{
+		return chunkDistance(level, x, z) < levelRange(level);
+	}
+
+	// Range of chunk coordinates of level that can be in range of the camera
+	void levelWindow(int level, int64_t &xStart, int64_t &xEnd, int64_t &zStart, int64_t &zEnd) const
+	{
+		int64_t width = chunkSize << level;
+		float range = levelRange(level);
+		int64_t cornerX = camera.cellX * worldCellSize;
+		int64_t cornerZ = camera.cellZ * worldCellSize;
+		xStart = floorDivide(cornerX + (int64_t)std::floor(camera.local.x - range), width);
+		xEnd = floorDivide(cornerX + (int64_t)std::floor(camera.local.x + range), width);
+		zStart = floorDivide(cornerZ + (int64_t)std::floor(camera.local.z - range), width);
+		zEnd = floorDivide(cornerZ + (int64_t)std::floor(camera.local.z + range), width);
+	}
+
+	bool isLoaded(int level, int64_t x, int64_t z) const
+	{
+		const ChunkSlot &slot = slots[slotIndex(level, x, z)];
+		return slot.loaded && slot.x == x && slot.z == z;
+	}
+
+	// Whether chunk (x, z) of level is being generated or waiting to be uploaded
+	bool isPending(int level, int64_t x, int64_t z) const
+	{
+		for (const PendingChunk &chunk : pending)
+		{
+			if (chunk.inFlight && chunk.level == level && chunk.x == x && chunk.z == z) return true;
+		}
+		return false;
+	}
+
+	/*
+	Selects chunk (x, z) of level to be drawn, replacing the quadrants whose children are in range with the
+	children. A chunk is only split once all of those children are loaded so there are never holes.
+	*/
+	void selectChunk(int level, int64_t x, int64_t z)
+	{
+		bool split = false;
+		bool ready = true;
+		for (int quadrant = 0; quadrant < 4 && level > 0; quadrant++)
+		{
+			int64_t childX = 2 * x + quadrant / 2;
+			int64_t childZ = 2 * z + quadrant % 2;
+			if (!inRange(level - 1, childX, childZ)) continue;
+			split = true;
+			if (!isLoaded(level - 1, childX, childZ)) ready = false;
+		}
+
+		if (!split || !ready)
+		{
+			select(level, x, z, allQuadrants);
+			return;
+		}
+
+		for (int quadrant = 0; quadrant < 4; quadrant++)
+		{
+			int64_t childX = 2 * x + quadrant / 2;
+			int64_t childZ = 2 * z + quadrant % 2;
+			if (inRange(level - 1, childX, childZ)) selectChunk(level - 1, childX, childZ);
+			else select(level, x, z, quadrant);
+		}
+	}
+
+	// Queues quadrant of chunk (x, z) of level to be culled and drawn
+	void select(int level, int64_t x, int64_t z, int quadrant)
+	{
+		int slot = slotIndex(level, x, z);
+		int64_t width = chunkSize << level;
+		SelectedChunk chunk;
+		chunk.level = level;
+		chunk.slot = slot;
+		chunk.quadrant = quadrant;
+		chunk.bounds.minimum = glm::vec3(camera.relativeX(x * width), slots[slot].minimumHeight, camera.relativeZ(z * width));
+		chunk.bounds.maximum = glm::vec3(camera.relativeX((x + 1) * width), slots[slot].maximumHeight, camera.relativeZ((z + 1) * width));
+		if (quadrant != allQuadrants)
+		{
+			if (quadrant / 2) chunk.bounds.minimum.x += 0.5f * width;
+			else chunk.bounds.maximum.x -= 0.5f * width;
+			if (quadrant % 2) chunk.bounds.minimum.z += 0.5f * width;
+			else chunk.bounds.maximum.z -= 0.5f * width;
+		}
+		float xDistance = std::max(std::max(chunk.bounds.minimum.x, -chunk.bounds.maximum.x), 0.0f);
+		float zDistance = std::max(std::max(chunk.bounds.minimum.z, -chunk.bounds.maximum.z), 0.0f);
+		chunk.distance = std::sqrt(xDistance * xDistance + zDistance * zDistance);
+		selected.push_back(chunk);
+	}
+
+	uint16_t quantise(float height) const
+	{
+		float normalised = (height - heightMinimum) / heightRange;
+		if (normalised < 0.0f) normalised = 0.0f;
+		if (normalised > 1.0f) normalised = 1.0f;
+		return (uint16_t)(normalised * 65535.0f + 0.5f);
+	}
+
+	float dequantise(uint16_t height) const
+	{
+		return heightMinimum + heightRange * (height / 65535.0f);
+	}
+
+	// Writes the x and z of the unit normal of a surface with slopes dx and dz, scaled to 8 bits
+	static void encodeNormal(float dx, float dz, int8_t *normal)
+	{
+		float scale = 127.0f / std::sqrt(dx * dx + 1.0f + dz * dz);
+		normal[0] = (int8_t)std::lround(-dx * scale);
+		normal[1] = (int8_t)std::lround(-dz * scale);
+	}
+
+	// Lowest and highest of every height in a chunk's vertices
+	void heightBounds(const Vertex *vertices, float &minimum, float &maximum) const
+	{
+		uint16_t lowest = 65535;
+		uint16_t highest = 0;
+		for (int i = 0; i < chunkVertexCount; i++)
+		{
+			lowest = std::min(lowest, std::min(vertices[i].height, vertices[i].morphHeight));
+			highest = std::max(highest, std::max(vertices[i].height, vertices[i].morphHeight));
+		}
+		minimum = dequantise(lowest);
+		maximum = dequantise(highest);
+	}
+
+	void addDraw(int slot, int quadrant)
+	{
+		DrawCommand command = {};
+		command.instanceCount = 1;
+		command.baseVertex = slot * chunkVertexCount;
+		if (quadrant == allQuadrants)
+		{
+			command.count = indexCount;
+			command.firstIndex = 0;
+			totals.trianglesDrawn += 2 * chunkSize * chunkSize;
+		}
+		else
+		{
+			command.count = quadrantIndexCount;
+			command.firstIndex = quadrant * quadrantIndexCount;
+			totals.trianglesDrawn += chunkSize * chunkSize / 2;
+		}
+
+		drawList.commands.push_back(command);
+		if (indirect) return;
+		drawList.counts.push_back(command.count);
+		drawList.offsets.push_back((const void *)(command.firstIndex * sizeof(ChunkIndex)));
+		drawList.baseVertices.push_back(command.baseVertex);
+	}
+
+	/*
+	Calculates perlin noise values for rows [rowStart, rowEnd) of the chunk, runs on a worker thread.
+	Vertices on even rows and columns lie on the coarser level's lattice so blend to its height there. The rest lie
+	on an edge or the diagonal of one of its squares so blend to the average of the two ends, which is exactly the
+	coarser level's surface. Normals come from the noise's analytic derivatives in the same evaluation as the
+	heights, and blend to the coarser level's normals the same way, averaging its slopes between lattice points.
+	If surfaceHeights isn't NULL the chunk's own heights and slopes were found beforehand and are read from it and
+	the slope arrays instead, one row of chunkVertexSize for each row from rowStart.
+	*/
+	void generateRows(PendingChunk &chunk, int rowStart, int rowEnd, const float *surfaceHeights = NULL, const float *surfaceSlopesX = NULL, const float *surfaceSlopesZ = NULL) const
+	{
+		ScopedTimer timer(profiler, profileNoise);
+		const FractalNoise &noise = levelNoise[chunk.level];
+		const bool topLevel = chunk.level == lodLevelCount - 1;
+		const int spacing = levelSpacing(chunk.level);
+
+		// Heights are found relative to the chunk's first vertex so far chunks are as precise as near ones
+		const NoiseOrigin origin = { chunk.x * chunkSize * spacing, chunk.z * chunkSize * spacing };
+
+		// Heights and slopes of the coarser level along the even rows from rowStart up to the first even row at or after rowEnd - 1
+		const int coarseSize = chunkSize / 2 + 1;
+		float coarse[tileRows / 2 + 1][coarseSize];
+		float coarseDx[tileRows / 2 + 1][coarseSize];
+		float coarseDz[tileRows / 2 + 1][coarseSize];
+		int lastRow = rowEnd - 1;
+		int lastEvenRow = lastRow + (lastRow & 1);
+		float zPositions[chunkVertexSize];
+		if (!topLevel)
+		{
+			for (int k = 0; k < coarseSize; k++) zPositions[k] = (float)(2 * k * spacing);
+			for (int i = rowStart; i <= lastEvenRow; i += 2)
+			{
+				int k = (i - rowStart) / 2;
+				morphNoise(chunk.level).heightRowWithDerivatives(origin, (float)(i * spacing), zPositions, coarse[k], coarseDx[k], coarseDz[k], coarseSize);
+			}
+		}
+		auto coarseHeight = [&coarse, rowStart](int i, int j) { return coarse[(i - rowStart) / 2][j / 2]; };
+		auto coarseSlopeX = [&coarseDx, rowStart](int i, int j) { return coarseDx[(i - rowStart) / 2][j / 2]; };
+		auto coarseSlopeZ = [&coarseDz, rowStart](int i, int j) { return coarseDz[(i - rowStart) / 2][j / 2]; };
+
+		// Heights are found a row at a time so the terms of the noise that only depend on x are shared by the row
+		for (int j = 0; j < chunkVertexSize; j++) zPositions[j] = (float)(j * spacing);
+		float rowHeights[chunkVertexSize];
+		float rowSlopesX[chunkVertexSize];
+		float rowSlopesZ[chunkVertexSize];
+		Vertex row[chunkVertexSize];
+		uint16_t lowest = 65535;
+		uint16_t highest = 0;
+		for (int i = rowStart; i < rowEnd; i++)
+		{
+			const float *heights = rowHeights;
+			const float *slopesX = rowSlopesX;
+			const float *slopesZ = rowSlopesZ;
+			if (surfaceHeights)
+			{
+				size_t offset = (size_t)(i - rowStart) * chunkVertexSize;
+				heights = surfaceHeights + offset;
+				slopesX = surfaceSlopesX + offset;
+				slopesZ = surfaceSlopesZ + offset;
+			}
+			else
+			{
+				noise.heightRowWithDerivatives(origin, (float)(i * spacing), zPositions, rowHeights, rowSlopesX, rowSlopesZ, chunkVertexSize);
+			}
+			for (int j = 0; j < chunkVertexSize; j++)
+			{
+				float morphHeight = heights[j];
+				float morphSlopeX = slopesX[j];
+				float morphSlopeZ = slopesZ[j];
+				if (!topLevel)
+				{
+					// Ends of the coarse edge or diagonal the vertex lies on, both the same point if it is on the lattice
+					bool oddRow = i & 1;
+					bool oddColumn = j & 1;
+					int i0 = i, j0 = j, i1 = i, j1 = j;
+					if (oddRow && oddColumn)
+					{
+						i0 = i - 1; j0 = j + 1;
+						i1 = i + 1; j1 = j - 1;
+					}
+					else if (oddRow)
+					{
+						i0 = i - 1;
+						i1 = i + 1;
+					}
+					else if (oddColumn)
+					{
+						j0 = j - 1;
+						j1 = j + 1;
+					}
+					morphHeight = 0.5f * (coarseHeight(i0, j0) + coarseHeight(i1, j1));
+					morphSlopeX = 0.5f * (coarseSlopeX(i0, j0) + coarseSlopeX(i1, j1));
+					morphSlopeZ = 0.5f * (coarseSlopeZ(i0, j0) + coarseSlopeZ(i1, j1));
+				}
+				Vertex &vertex = row[j];
+				vertex.height = quantise(heights[j]);
+				vertex.morphHeight = quantise(morphHeight);
+				encodeNormal(slopesX[j], slopesZ[j], vertex.normal);
+				encodeNormal(morphSlopeX, morphSlopeZ, vertex.morphNormal);
+				lowest = std::min(lowest, std::min(vertex.height, vertex.morphHeight));
+				highest = std::max(highest, std::max(vertex.height, vertex.morphHeight));
+			}
+
+			// Staging memory is write combined so rows are written out whole and never read back
+			std::memcpy(chunk.out + chunkVertexSize * i, row, sizeof(row));
+			if (chunk.cacheOut) std::memcpy(chunk.cacheOut + chunkVertexSize * i, row, sizeof(row));
+		}
+		int fineSamples = surfaceHeights ? 0 : (rowEnd - rowStart) * chunkVertexSize;
+		if (profiler) profiler->addSamples(fineSamples + (topLevel ? 0 : (lastEvenRow - rowStart) / 2 + 1) * coarseSize);
+		chunk.tileMinimum[rowStart / tileRows] = dequantise(lowest);
+		chunk.tileMaximum[rowStart / tileRows] = dequantise(highest);
+	}
+
+	/*
+	Erodes rows [rowStart, rowEnd) of a chunk and generates their vertices, runs on a worker thread. The raw heights
+	are found for the rows and a halo around them as wide as the number of iterations, plus one more point on
+	every side so the eroded heights next to the rows are known too and the normals can be found from the
+	differences across each vertex. The coarser level's surface the vertices blend into isn't eroded, so erosion
+	fades out towards the far edge of the level.
+	*/
+	void generateErodedRows(PendingChunk &chunk, int rowStart, int rowEnd) const
+	{
+		const int spacing = levelSpacing(chunk.level);
+		const int halo = erosion.iterations + 1;
+		const int rows = rowEnd - rowStart + 2 * halo;
+		const int columns = chunkVertexSize + 2 * halo;
+		const int maxHalo = maxErosionIterations + 1;
+		float heights[erosionTileRows * chunkVertexSize];
+		float slopesX[erosionTileRows * chunkVertexSize];
+		float slopesZ[erosionTileRows * chunkVertexSize];
+		{
+			ScopedTimer timer(profiler, profileNoise);
+			const NoiseOrigin origin = { chunk.x * chunkSize * spacing, chunk.z * chunkSize * spacing };
+			float grid[(erosionTileRows + 2 * maxHalo) * (chunkVertexSize + 2 * maxHalo)];
+			float scratch[(erosionTileRows + 2 * maxHalo) * (chunkVertexSize + 2 * maxHalo)];
+			float zPositions[chunkVertexSize + 2 * maxHalo];
+			for (int k = 0; k < columns; k++) zPositions[k] = (float)((k - halo) * spacing);
+			for (int r = 0; r < rows; r++)
+			{
+				levelNoise[chunk.level].heightRow(origin, (float)((rowStart - halo + r) * spacing), zPositions, grid + r * columns, columns);
+			}
+			erodeThermal(erosion, (float)spacing, grid, scratch, rows, columns);
+
+			// Central differences across each vertex, the rows run along x and the columns along z
+			const float differenceScale = 0.5f / spacing;
+			for (int i = rowStart; i < rowEnd; i++)
+			{
+				for (int j = 0; j < chunkVertexSize; j++)
+				{
+					const float *point = grid + (i - rowStart + halo) * columns + j + halo;
+					size_t index = (size_t)(i - rowStart) * chunkVertexSize + j;
+					heights[index] = *point;
+					slopesX[index] = differenceScale * (point[columns] - point[-columns]);
+					slopesZ[index] = differenceScale * (point[1] - point[-1]);
+				}
+			}
+			if (profiler) profiler->addSamples(rows * columns);
+		}
+
+		// Builds the vertices a tile at a time so every tile's height bounds are found as usual
+		for (int tile = rowStart; tile < rowEnd; tile += tileRows)
+		{
+			size_t offset = (size_t)(tile - rowStart) * chunkVertexSize;
+			generateRows(chunk, tile, std::min(tile + tileRows, rowEnd), heights + offset, slopesX + offset, slopesZ + offset);
+		}
+	}
+
+	/*
+	Copies finished chunks over their slots on the GPU, in the order they finished, until budget runs out. Chunks
+	that don't fit wait for the next frame.
+	*/
+	void uploadFinished(size_t &budget)
+	{
+		ScopedTimer timer(profiler, profileUpload);
+		while (MpscNode *node = finished.pop())
+		{
+			ready[(readyStart + readyCount) % chunkBufferCount] = static_cast<PendingChunk *>(node);
+			readyCount++;
+		}
+
+		while (readyCount > 0)
+		{
+			PendingChunk &chunk = *ready[readyStart];
+
+			// The camera may have moved on while the chunk was being generated, which costs nothing to skip
+			bool needed = inRange(chunk.level, chunk.x, chunk.z);
+			if (needed && budget < chunkBytes) break;
+			readyStart = (readyStart + 1) % chunkBufferCount;
+			readyCount--;
+			totals.chunksGenerated++;
+
+			int buffer = (int)(&chunk - pending);
+			if (needed)
+			{
+				int slot = slotIndex(chunk.level, chunk.x, chunk.z);
+				staging.copy(buffer, vertexBuffer, slot * chunkBytes);
+				float minimum = *std::min_element(chunk.tileMinimum, chunk.tileMinimum + tilesPerChunk);
+				float maximum = *std::max_element(chunk.tileMaximum, chunk.tileMaximum + tilesPerChunk);
+				slots[slot] = { chunk.x, chunk.z, true, minimum, maximum };
+				budget -= chunkBytes;
+				totals.bytesUploaded += chunkBytes;
+			}
+
+			// Finished chunks are kept in the cache even if they are no longer needed
+			if (chunk.cacheOut) tileCache->commit(chunk.x, chunk.z, levelHash[chunk.level]);
+			chunk.inFlight = false;
+			staging.release(buffer);
+		}
+	}
+
+	ChunkSlot slots[slotCount];
+
+	// Noise evaluated by each level, with the octaves too fine for its spacing removed
+	FractalNoise levelNoise[lodLevelCount];
+
+	// Range heights are quantised over
+	float heightMinimum = 0.0f;
+	float heightRange = 1.0f;
+
+	// Camera position at the last update
+	WorldPosition camera;
+
+	// Chunks chosen to be drawn this frame before and after frustum culling
+	std::vector<SelectedChunk> selected;
+	std::vector<SelectedChunk> visible;
+	HorizonCuller horizonCuller;
+
+	DrawList drawList;
+	bool indirect = false;
+	unsigned int indirectBuffer = 0;
+
+	ThreadPool *threadPool = NULL;
+	GpuTerrainGenerator *gpuGenerator = NULL;
+	TileCache *tileCache = NULL;
+	Profiler *profiler = NULL;
+	bool synchronous = false;
+	ChunkStatistics totals;
+	uint64_t levelHash[lodLevelCount] = {};
+
+	ThermalErosion erosion;
+
+	// Every task generating chunks, only waited on when the manager is destroyed
+	TaskGroup generation;
+
+	// Chunks being generated or waiting to be uploaded, each written into the staging buffer with the same index
+	StagingPool staging;
+	PendingChunk pending[chunkBufferCount];
+
+	/*
+	Finished chunks handed over by the workers, then those taken off the queue but not yet uploaded, in a ring as
+	there can be no more of them than there are pending chunks
+	*/
+	MpscQueue finished;
+	PendingChunk *ready[chunkBufferCount] = {};
+	int readyStart = 0;
+	int readyCount = 0;
+
+	// Lists of chunks to load, reset at the start of every update
+	FrameArena scratch;
+
+	unsigned int vertexBuffer = 0;
+	unsigned int vertexArray = 0;
+	unsigned int elementBuffer = 0;
+	unsigned int indexCount = 0;
+	unsigned int quadrantIndexCount = 0;
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Axis aligned bounding box
+struct BoundingBox
+{
+	glm::vec3 minimum;
+	glm::vec3 maximum;
+};
+
+/*
+View frustum as six planes extracted from a combined projection and view matrix (Gribb and Hartmann). Each plane
+is stored as (a, b, c, d) with the inside where a * x + b * y + c * z + d >= 0.
+*/
+struct Frustum
+{
+	glm::vec4 planes[6];
+
+	explicit Frustum(const glm::mat4 &matrix)
+	{
+		// glm matrices are column major, so row r is matrix[0][r] to matrix[3][r]
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int side = 0; side < 2; side++)
+			{
+				float sign = side == 0 ? 1.0f : -1.0f;
+				glm::vec4 &plane = planes[2 * axis + side];
+				for (int column = 0; column < 4; column++) plane[column] = matrix[column][3] + sign * matrix[column][axis];
+			}
+		}
+	}
+
+	// Whether any part of box may be inside, only boxes entirely behind one of the planes are rejected
+	bool intersects(const BoundingBox &box) const
+	{
+		for (const glm::vec4 &plane : planes)
+		{
+			// Corner of the box furthest along the plane's normal
+			float x = plane.x >= 0.0f ? box.maximum.x : box.minimum.x;
+			float y = plane.y >= 0.0f ? box.maximum.y : box.minimum.y;
+			float z = plane.z >= 0.0f ? box.maximum.z : box.minimum.z;
+			if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f) return false;
+		}
+		return true;
+	}
+};
+
+// Number of directions around the camera the horizon is tracked in
+const int horizonBuckets = 512;
+
+/*
+Conservative horizon culling for a heightfield.
+Boxes are tested front to back. Every box that is drawn becomes an occluder: terrain is a heightfield so every ray
+leaving the camera in a direction the box fully covers passes over its footprint, somewhere between its nearest and
+furthest distance, where the surface is no lower than the box's minimum height. For each direction the horizon
+stores the steepest slope (rise over distance) a ray can have and still be blocked, and a box further away than
+an occluder is hidden if the steepest slope to its top is below the horizon in every direction it covers.
+*/
+class HorizonCuller
+{
+public:
+	void begin(const glm::vec3 &camera)
+	{
+		cameraPosition = camera;
+		std::fill(horizon, horizon + horizonBuckets, -INFINITY);
+		occluders.clear();
+	}
+
+	// Whether box is hidden behind the occluders added so far, boxes must be tested in order of increasing distance
+	bool hidden(const BoundingBox &box)
+	{
+		float nearest, furthest;
+		distances(box, nearest, furthest);
+		if (nearest <= 0.0f) return false;
+
+		// Only occluders entirely in front of the box can hide it
+		while (!occluders.empty() && occluders.front().furthest < nearest)
+		{
+			std::pop_heap(occluders.begin(), occluders.end(), furthestLast);
+			addToHorizon(occluders.back());
+			occluders.pop_back();
+		}
+
+		float rise = box.maximum.y - cameraPosition.y;
+		float slope = rise / (rise >= 0.0f ? nearest : furthest);
+		int first, last;
+		if (!angularSpan(box, false, first, last)) return false;
+		for (int bucket = first; bucket <= last; bucket++)
+		{
+			if (horizon[bucket & (horizonBuckets - 1)] <= slope) return false;
+		}
+		return true;
+	}
+
+	// Adds a box that is drawn as an occluder of the boxes after it
+	void addOccluder(const BoundingBox &box)
+	{
+		Occluder occluder;
+		occluder.box = box;
+		float nearest;
+		distances(box, nearest, occluder.furthest);
+		if (nearest <= 0.0f) return;
+
+		float rise = box.minimum.y - cameraPosition.y;
+		occluder.slope = rise / (rise >= 0.0f ? occluder.furthest : nearest);
+		occluders.push_back(occluder);
+		std::push_heap(occluders.begin(), occluders.end(), furthestLast);
+	}
+
+private:
+	struct Occluder
+	{
+		BoundingBox box;
+		float furthest;
+		float slope;
+	};
+
+	// Orders the heap so the occluder finishing closest to the camera is at the front
+	static bool furthestLast(const Occluder &a, const Occluder &b)
+	{
+		return a.furthest > b.furthest;
+	}
+
+	// Closest and furthest distance along the xz plane from the camera to the box
+	void distances(const BoundingBox &box, float &nearest, float &furthest) const
+	{
+		float xNear = std::max(std::max(box.minimum.x - cameraPosition.x, cameraPosition.x - box.maximum.x), 0.0f);
+		float zNear = std::max(std::max(box.minimum.z - cameraPosition.z, cameraPosition.z - box.maximum.z), 0.0f);
+		float xFar = std::max(std::abs(box.minimum.x - cameraPosition.x), std::abs(box.maximum.x - cameraPosition.x));
+		float zFar = std::max(std::abs(box.minimum.z - cameraPosition.z), std::abs(box.maximum.z - cameraPosition.z));
+		nearest = std::sqrt(xNear * xNear + zNear * zNear);
+		furthest = std::sqrt(xFar * xFar + zFar * zFar);
+	}
+
+	/*
+	Buckets covered by the box as seen from the camera, which must be outside its footprint. With covered false
+	this is every bucket the box touches, with covered true only those it spans entirely. Returns false if there
+	are none. last may be past horizonBuckets, bucket indices wrap.
+	*/
+	bool angularSpan(const BoundingBox &box, bool covered, int &first, int &last) const
+	{
+		const float pi = 3.14159265f;
+		float centreX = 0.5f * (box.minimum.x + box.maximum.x) - cameraPosition.x;
+		float centreZ = 0.5f * (box.minimum.z + box.maximum.z) - cameraPosition.z;
+		float centre = std::atan2(centreZ, centreX);
+
+		// Angles of the corners relative to the centre lie within half a turn as the camera is outside the box
+		float lowest = 0.0f;
+		float highest = 0.0f;
+		for (int corner = 0; corner < 4; corner++)
+		{
+			float x = (corner & 1 ? box.maximum.x : box.minimum.x) - cameraPosition.x;
+			float z = (corner & 2 ? box.maximum.z : box.minimum.z) - cameraPosition.z;
+			float angle = std::atan2(z, x) - centre;
+			if (angle > pi) angle -= 2.0f * pi;
+			if (angle < -pi) angle += 2.0f * pi;
+			lowest = std::min(lowest, angle);
+			highest = std::max(highest, angle);
+		}
+
+		float scale = horizonBuckets / (2.0f * pi);
+		float start = (centre + lowest + pi) * scale;
+		float end = (centre + highest + pi) * scale;
+		if (covered)
+		{
+			first = (int)std::ceil(start);
+			last = (int)std::floor(end) - 1;
+		}
+		else
+		{
+			first = (int)std::floor(start);
+			last = (int)std::floor(end);
+		}
+		return first <= last;
+	}
+
+	void addToHorizon(const Occluder &occluder)
+	{
+		int first, last;
+		if (!angularSpan(occluder.box, true, first, last)) return;
+		for (int bucket = first; bucket <= last; bucket++)
+		{
+			float &height = horizon[bucket & (horizonBuckets - 1)];
+			height = std::max(height, occluder.slope);
+		}
+	}
+
+	glm::vec3 cameraPosition;
+	float horizon[horizonBuckets];
+
+	// Occluders not yet in the horizon, a heap ordered by furthest distance
+	std::vector<Occluder> occluders;
+};
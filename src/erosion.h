@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+
+/*
+Thermal erosion, run over the heights of each chunk of the finest level after they are generated.
+Wherever the height difference between a point and one of its four neighbours is steeper than the talus slope,
+rate of the excess slides downhill, which wears cliffs and sharp ridges into scree slopes. The material moved
+between two points only depends on their two heights, so one iteration changes each point by an amount found from
+it and its neighbours alone: after n iterations a point only depends on the heights within n points of it. Chunks
+are therefore eroded a tile of rows at a time, each tile evaluating a halo of iterations extra points around itself,
+and every tile of every chunk gives the same heights as eroding the whole world at once, whatever order the
+workers run them in.
+*/
+
+// Most iterations a chunk can be eroded with, bounds the halo evaluated around each tile
+const int maxErosionIterations = 32;
+
+struct ThermalErosion
+{
+	int iterations = 0; // 0 turns erosion off
+	float talus = 0.6f; // Steepest height difference between neighbours, per world unit, that is left alone
+	float rate = 0.2f; // Fraction of the excess moved per iteration, at most 0.25 so no point can overshoot
+
+	bool enabled() const
+	{
+		return iterations > 0;
+	}
+
+	// Hash of every parameter, folded into the hash chunks are cached under
+	uint64_t hash() const
+	{
+		if (!enabled()) return 0;
+		uint32_t talusBits, rateBits;
+		std::memcpy(&talusBits, &talus, sizeof(talusBits));
+		std::memcpy(&rateBits, &rate, sizeof(rateBits));
+		uint64_t result = 14695981039346656037ull;
+		for (uint64_t value : { (uint64_t)iterations, (uint64_t)talusBits, (uint64_t)rateBits })
+		{
+			result ^= value;
+			result *= 1099511628211ull;
+		}
+		return result;
+	}
+};
+
+/*
+Erodes a rows by columns grid of heights, a world unit of spacing apart, in place. scratch must hold as many
+heights. The outermost iterations rows and columns are only halo: each iteration spreads the error of not knowing
+what lies beyond the grid one point further in, so only the points at least iterations from every edge hold the
+eroded heights.
+*/
+inline void erodeThermal(const ThermalErosion &erosion, float spacing, float *heights, float *scratch, int rows, int columns)
+{
+	const float talus = erosion.talus * spacing;
+	const float rate = erosion.rate;
+
+	// Height that moves from a point at b to its neighbour at a, negative if it moves the other way
+	auto inflow = [talus, rate](float a, float b)
+	{
+		float difference = a - b;
+		if (difference > talus) return rate * (difference - talus);
+		if (difference < -talus) return rate * (difference + talus);
+		return 0.0f;
+	};
+
+	// The edges are never changed as their neighbours beyond the grid aren't known
+	float *from = heights;
+	float *to = scratch;
+	std::memcpy(scratch, heights, (size_t)rows * columns * sizeof(float));
+	for (int iteration = 0; iteration < erosion.iterations; iteration++)
+	{
+		for (int r = 1; r + 1 < rows; r++)
+		{
+			for (int c = 1; c + 1 < columns; c++)
+			{
+				const float *point = from + r * columns + c;
+				float height = *point;
+				float change = inflow(point[-columns], height) + inflow(point[columns], height) + inflow(point[-1], height) + inflow(point[1], height);
+				to[r * columns + c] = height + change;
+			}
+		}
+		float *swap = from;
+		from = to;
+		to = swap;
+	}
+	if (from != heights) std::memcpy(heights, from, (size_t)rows * columns * sizeof(float));
+}
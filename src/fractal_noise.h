@@ -0,0 +1,484 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "noise.h"
+
+/*
+Fractal (multi-octave) noise.
+The height of a point is the sum of several octaves of noiseValue, each at a different scale and amplitude, which
+is then shaped with pow(sum, exponent) + offset. FractalNoise holds the octaves at runtime so it can be built and
+tuned freely, while FixedFractalNoise is a constexpr description whose octave count is part of the type so
+fractalHeight and fractalHeightBatch can unroll the loop over octaves and fold every scale into a constant.
+*/
+
+// Points are processed in blocks of this size so batch scratch arrays can live on the stack
+const size_t fractalBlockSize = 64;
+
+/*
+Integer world position that heights can be found relative to, with points given as small float offsets from it.
+Each octave splits origin * frequency into whole lattice cells and a remainder in double precision, so the noise
+sees the same small coordinates however far the origin is from the world origin.
+*/
+struct NoiseOrigin
+{
+	int64_t x, z;
+};
+
+// Splits coordinate * frequency into whole lattice cells, wrapped to 32 bits, and the remainder between 0 and 1
+inline void splitOrigin(int64_t coordinate, float frequency, int32_t &cells, float &remainder)
+{
+	double scaled = (double)coordinate * frequency;
+	double whole = std::floor(scaled);
+	remainder = (float)(scaled - whole);
+	cells = (int32_t)(uint32_t)(uint64_t)(int64_t)whole;
+}
+
+// One frequency of noise in the sum
+struct Octave
+{
+	float scale; // Distance in world units between the octave's lattice points
+	float amplitude; // Height the octave's noise value is multiplied by
+};
+
+// Octaves and shaping known at compile time
+template <int OctaveCount>
+struct FixedFractalNoise
+{
+	static const int octaveCount = OctaveCount;
+	Octave octaves[OctaveCount];
+	float exponent;
+	float offset;
+};
+
+/*
+The terrain drawn by the renderer, which evaluates it through a FractalNoise copy so each level of detail can drop
+the octaves too fine for it. fractalHeight and terrainHeight keep the compile time evaluation of it only as the
+reference the benchmark checks every other path against.
+A broad overtone followed by octaves that halve in scale and amplitude, summed and raised to the power of 1.2 to
+add excentuated peaks.
+*/
+constexpr FixedFractalNoise<6> terrainNoise = {
+	{ { 256, 64 }, { 64, 32 }, { 32, 16 }, { 16, 8 }, { 8, 4 }, { 4, 2 } },
+	1.2f,
+	-140.0f
+};
+
+// Contribution of octave Index at (x, z), the frequency and amplitude are compile time constants
+template <const auto &Noise, int Index>
+inline float octaveHeight(float x, float z)
+{
+	constexpr float frequency = 1.0f / Noise.octaves[Index].scale;
+	constexpr float amplitude = Noise.octaves[Index].amplitude;
+	return amplitude * noiseValue(x * frequency, z * frequency);
+}
+
+template <const auto &Noise, int... Index>
+inline float sumOctaves(float x, float z, std::integer_sequence<int, Index...>)
+{
+	float sum = 0.0f;
+	((sum += octaveHeight<Noise, Index>(x, z)), ...);
+	return sum;
+}
+
+// Height of the fractal noise at (x, z) for a description known at compile time
+template <const auto &Noise>
+inline float fractalHeight(float x, float z)
+{
+	float sum = sumOctaves<Noise>(x, z, std::make_integer_sequence<int, Noise.octaveCount>());
+	return pow(sum, Noise.exponent) + Noise.offset;
+}
+
+/*
+Adds amplitude * noiseValue((origin + x) * frequency, (origin + z) * frequency) to sum for count (at most
+fractalBlockSize) points. With origin at 0 the results are the same as evaluating the octave at x and z directly.
+*/
+inline void accumulateOctave(const NoiseTable &table, NoiseOrigin origin, const float *x, const float *z, float *sum, size_t count, float frequency, float amplitude)
+{
+	LatticeOffset offset;
+	float remainderX, remainderZ;
+	splitOrigin(origin.x, frequency, offset.x, remainderX);
+	splitOrigin(origin.z, frequency, offset.z, remainderZ);
+
+	float scaledX[fractalBlockSize];
+	float scaledZ[fractalBlockSize];
+	float octave[fractalBlockSize];
+	for (size_t i = 0; i < count; i++)
+	{
+		scaledX[i] = remainderX + x[i] * frequency;
+		scaledZ[i] = remainderZ + z[i] * frequency;
+	}
+	noiseValueBatch(table, offset, scaledX, scaledZ, octave, count);
+	for (size_t i = 0; i < count; i++) sum[i] += amplitude * octave[i];
+}
+
+// accumulateOctave that also adds the octave's derivatives, scaled by amplitude * frequency, to dx and dz
+inline void accumulateOctaveWithDerivatives(const NoiseTable &table, NoiseOrigin origin, const float *x, const float *z, float *sum, float *dx, float *dz, size_t count, float frequency, float amplitude)
+{
+	LatticeOffset offset;
+	float remainderX, remainderZ;
+	splitOrigin(origin.x, frequency, offset.x, remainderX);
+	splitOrigin(origin.z, frequency, offset.z, remainderZ);
+
+	float scaledX[fractalBlockSize];
+	float scaledZ[fractalBlockSize];
+	float octave[fractalBlockSize];
+	float octaveX[fractalBlockSize];
+	float octaveZ[fractalBlockSize];
+	for (size_t i = 0; i < count; i++)
+	{
+		scaledX[i] = remainderX + x[i] * frequency;
+		scaledZ[i] = remainderZ + z[i] * frequency;
+	}
+	noiseValueWithDerivativesBatch(table, offset, scaledX, scaledZ, octave, octaveX, octaveZ, count);
+	float slopeScale = amplitude * frequency;
+	for (size_t i = 0; i < count; i++)
+	{
+		sum[i] += amplitude * octave[i];
+		dx[i] += slopeScale * octaveX[i];
+		dz[i] += slopeScale * octaveZ[i];
+	}
+}
+
+/*
+accumulateOctave for count points along the row at x, at (x, z[i]). The octave's x coordinate and the terms of the
+noise that only depend on it are found once rather than for every point, the results are the same as
+accumulateOctave with every x the same.
+*/
+inline void accumulateOctaveRow(const NoiseTable &table, NoiseOrigin origin, float x, const float *z, float *sum, size_t count, float frequency, float amplitude)
+{
+	LatticeOffset offset;
+	float remainderX, remainderZ;
+	splitOrigin(origin.x, frequency, offset.x, remainderX);
+	splitOrigin(origin.z, frequency, offset.z, remainderZ);
+
+	float scaledZ[fractalBlockSize];
+	float octave[fractalBlockSize];
+	for (size_t i = 0; i < count; i++) scaledZ[i] = remainderZ + z[i] * frequency;
+	noiseValueRow(table, offset, remainderX + x * frequency, scaledZ, octave, count);
+	for (size_t i = 0; i < count; i++) sum[i] += amplitude * octave[i];
+}
+
+// accumulateOctaveRow that also adds the octave's derivatives, scaled by amplitude * frequency, to dx and dz
+inline void accumulateOctaveRowWithDerivatives(const NoiseTable &table, NoiseOrigin origin, float x, const float *z, float *sum, float *dx, float *dz, size_t count, float frequency, float amplitude)
+{
+	LatticeOffset offset;
+	float remainderX, remainderZ;
+	splitOrigin(origin.x, frequency, offset.x, remainderX);
+	splitOrigin(origin.z, frequency, offset.z, remainderZ);
+
+	float scaledZ[fractalBlockSize];
+	float octave[fractalBlockSize];
+	float octaveX[fractalBlockSize];
+	float octaveZ[fractalBlockSize];
+	for (size_t i = 0; i < count; i++) scaledZ[i] = remainderZ + z[i] * frequency;
+	noiseValueWithDerivativesRow(table, offset, remainderX + x * frequency, scaledZ, octave, octaveX, octaveZ, count);
+	float slopeScale = amplitude * frequency;
+	for (size_t i = 0; i < count; i++)
+	{
+		sum[i] += amplitude * octave[i];
+		dx[i] += slopeScale * octaveX[i];
+		dz[i] += slopeScale * octaveZ[i];
+	}
+}
+
+template <const auto &Noise, int... Index>
+inline void sumOctavesBatch(const float *x, const float *z, float *sum, size_t count, std::integer_sequence<int, Index...>)
+{
+	(accumulateOctave(classicNoiseTable, NoiseOrigin(), x, z, sum, count, 1.0f / Noise.octaves[Index].scale, Noise.octaves[Index].amplitude), ...);
+}
+
+// Finds fractalHeight for n points at (x[i], z[i]) using noiseValueBatch
+template <const auto &Noise>
+inline void fractalHeightBatch(const float *x, const float *z, float *out, size_t n)
+{
+	float sum[fractalBlockSize];
+	for (size_t start = 0; start < n; start += fractalBlockSize)
+	{
+		size_t count = n - start < fractalBlockSize ? n - start : fractalBlockSize;
+		for (size_t i = 0; i < count; i++) sum[i] = 0.0f;
+		sumOctavesBatch<Noise>(x + start, z + start, sum, count, std::make_integer_sequence<int, Noise.octaveCount>());
+		for (size_t i = 0; i < count; i++) out[start + i] = pow(sum[i], Noise.exponent) + Noise.offset;
+	}
+}
+
+// Octaves and shaping chosen at runtime
+class FractalNoise
+{
+public:
+	std::vector<Octave> octaves;
+	float constant = 0.0f; // Added to the sum of the octaves, stands in for the average of octaves that were removed
+	float exponent = 1.0f;
+	float offset = 0.0f;
+	NoiseTable table = classicNoiseTable; // Seed and lattice every octave is sampled from
+
+	FractalNoise() {}
+
+	// Copies a compile time description
+	template <int OctaveCount>
+	explicit FractalNoise(const FixedFractalNoise<OctaveCount> &noise)
+		: octaves(noise.octaves, noise.octaves + OctaveCount), exponent(noise.exponent), offset(noise.offset)
+	{
+	}
+
+	/*
+	Builds octaveCount octaves starting at scale and amplitude, each subsequent octave having its scale divided
+	by lacunarity and its amplitude multiplied by gain.
+	*/
+	static FractalNoise geometric(int octaveCount, float scale, float amplitude, float lacunarity, float gain, float exponent = 1.0f, float offset = 0.0f)
+	{
+		FractalNoise noise;
+		for (int i = 0; i < octaveCount; i++)
+		{
+			noise.octaves.push_back({ scale, amplitude });
+			scale /= lacunarity;
+			amplitude *= gain;
+		}
+		noise.exponent = exponent;
+		noise.offset = offset;
+		return noise;
+	}
+
+	// Copy of the noise that samples the lattice of seed instead, a different world with the same shape
+	FractalNoise withSeed(uint64_t seed, NoiseLattice lattice = noisePermutationLattice) const
+	{
+		FractalNoise noise = *this;
+		noise.table = buildNoiseTable(seed, lattice);
+		return noise;
+	}
+
+	/*
+	Copy for sampling at a coarser spacing, octaves with a scale below minimumScale would only alias so are replaced
+	by their average value (half their amplitude) which keeps the overall height of the terrain unchanged.
+	*/
+	FractalNoise withoutOctavesFinerThan(float minimumScale) const
+	{
+		FractalNoise noise = *this;
+		noise.octaves.clear();
+		for (const Octave &octave : octaves)
+		{
+			if (octave.scale >= minimumScale) noise.octaves.push_back(octave);
+			else noise.constant += 0.5f * octave.amplitude;
+		}
+		return noise;
+	}
+
+	// Height of the fractal noise at (x, z)
+	float height(float x, float z) const
+	{
+		float sum = constant;
+		for (const Octave &octave : octaves)
+		{
+			float frequency = 1.0f / octave.scale;
+			sum += octave.amplitude * noiseValue(table, x * frequency, z * frequency);
+		}
+		return pow(sum, exponent) + offset;
+	}
+
+	// Height of the fractal noise at (x, z) from origin, see NoiseOrigin
+	float height(NoiseOrigin origin, float x, float z) const
+	{
+		float sum = constant;
+		for (const Octave &octave : octaves)
+		{
+			float frequency = 1.0f / octave.scale;
+			LatticeOffset cells;
+			float remainderX, remainderZ;
+			splitOrigin(origin.x, frequency, cells.x, remainderX);
+			splitOrigin(origin.z, frequency, cells.z, remainderZ);
+			sum += octave.amplitude * noiseValue(table, remainderX + x * frequency, remainderZ + z * frequency, cells);
+		}
+		return pow(sum, exponent) + offset;
+	}
+
+	/*
+	Height of the fractal noise at (x, z) with its slope along x and z. Each octave's derivatives are scaled by its
+	amplitude and frequency, and the chain rule through pow gives exponent * pow(sum, exponent - 1) times the sum of
+	them. The height is the same as height(x, z).
+	*/
+	NoiseSample heightWithDerivatives(float x, float z) const
+	{
+		float sum = constant;
+		float dx = 0.0f;
+		float dz = 0.0f;
+		for (const Octave &octave : octaves)
+		{
+			float frequency = 1.0f / octave.scale;
+			NoiseSample sample = noiseValueWithDerivatives(table, x * frequency, z * frequency);
+			sum += octave.amplitude * sample.value;
+			dx += octave.amplitude * frequency * sample.dx;
+			dz += octave.amplitude * frequency * sample.dz;
+		}
+		float shaped = pow(sum, exponent) + offset;
+		float slope = exponent * pow(sum, exponent - 1.0f);
+		return { shaped, slope * dx, slope * dz };
+	}
+
+	// Finds height for n points at (x[i], z[i]) using noiseValueBatch
+	void heightBatch(const float *x, const float *z, float *out, size_t n) const
+	{
+		heightBatch(NoiseOrigin(), x, z, out, n);
+	}
+
+	// Finds height for n points at (x[i], z[i]) from origin
+	void heightBatch(NoiseOrigin origin, const float *x, const float *z, float *out, size_t n) const
+	{
+		float sum[fractalBlockSize];
+		for (size_t start = 0; start < n; start += fractalBlockSize)
+		{
+			size_t count = n - start < fractalBlockSize ? n - start : fractalBlockSize;
+			for (size_t i = 0; i < count; i++) sum[i] = constant;
+			for (const Octave &octave : octaves)
+			{
+				accumulateOctave(table, origin, x + start, z + start, sum, count, 1.0f / octave.scale, octave.amplitude);
+			}
+			for (size_t i = 0; i < count; i++) out[start + i] = pow(sum[i], exponent) + offset;
+		}
+	}
+
+	// Finds heightWithDerivatives for n points, writing the slopes to dx and dz
+	void heightBatchWithDerivatives(const float *x, const float *z, float *out, float *dx, float *dz, size_t n) const
+	{
+		heightBatchWithDerivatives(NoiseOrigin(), x, z, out, dx, dz, n);
+	}
+
+	// Finds heightWithDerivatives for n points at (x[i], z[i]) from origin
+	void heightBatchWithDerivatives(NoiseOrigin origin, const float *x, const float *z, float *out, float *dx, float *dz, size_t n) const
+	{
+		float sum[fractalBlockSize];
+		for (size_t start = 0; start < n; start += fractalBlockSize)
+		{
+			size_t count = n - start < fractalBlockSize ? n - start : fractalBlockSize;
+			for (size_t i = 0; i < count; i++)
+			{
+				sum[i] = constant;
+				dx[start + i] = 0.0f;
+				dz[start + i] = 0.0f;
+			}
+			for (const Octave &octave : octaves)
+			{
+				accumulateOctaveWithDerivatives(table, origin, x + start, z + start, sum, dx + start, dz + start, count, 1.0f / octave.scale, octave.amplitude);
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				float slope = exponent * pow(sum[i], exponent - 1.0f);
+				out[start + i] = pow(sum[i], exponent) + offset;
+				dx[start + i] *= slope;
+				dz[start + i] *= slope;
+			}
+		}
+	}
+
+	// Finds height for n points along the row at x, at (x, z[i]) from origin, the same as heightBatch but faster
+	void heightRow(NoiseOrigin origin, float x, const float *z, float *out, size_t n) const
+	{
+		float sum[fractalBlockSize];
+		for (size_t start = 0; start < n; start += fractalBlockSize)
+		{
+			size_t count = n - start < fractalBlockSize ? n - start : fractalBlockSize;
+			for (size_t i = 0; i < count; i++) sum[i] = constant;
+			for (const Octave &octave : octaves)
+			{
+				accumulateOctaveRow(table, origin, x, z + start, sum, count, 1.0f / octave.scale, octave.amplitude);
+			}
+			for (size_t i = 0; i < count; i++) out[start + i] = pow(sum[i], exponent) + offset;
+		}
+	}
+
+	// Finds heightWithDerivatives for n points along the row at x, the same as heightBatchWithDerivatives
+	void heightRowWithDerivatives(NoiseOrigin origin, float x, const float *z, float *out, float *dx, float *dz, size_t n) const
+	{
+		float sum[fractalBlockSize];
+		for (size_t start = 0; start < n; start += fractalBlockSize)
+		{
+			size_t count = n - start < fractalBlockSize ? n - start : fractalBlockSize;
+			for (size_t i = 0; i < count; i++)
+			{
+				sum[i] = constant;
+				dx[start + i] = 0.0f;
+				dz[start + i] = 0.0f;
+			}
+			for (const Octave &octave : octaves)
+			{
+				accumulateOctaveRowWithDerivatives(table, origin, x, z + start, sum, dx + start, dz + start, count, 1.0f / octave.scale, octave.amplitude);
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				float slope = exponent * pow(sum[i], exponent - 1.0f);
+				out[start + i] = pow(sum[i], exponent) + offset;
+				dx[start + i] *= slope;
+				dz[start + i] *= slope;
+			}
+		}
+	}
+
+	// Hash of every parameter that affects the heights, used to tell apart data generated with different noise
+	uint64_t hash() const
+	{
+		uint64_t result = 14695981039346656037ull;
+		auto combineBits = [&result](uint64_t bits)
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				result ^= (bits >> (8 * i)) & 0xFF;
+				result *= 1099511628211ull;
+			}
+		};
+		auto combine = [&result](float value)
+		{
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			for (int i = 0; i < 4; i++)
+			{
+				result ^= (bits >> (8 * i)) & 0xFF;
+				result *= 1099511628211ull;
+			}
+		};
+		for (const Octave &octave : octaves)
+		{
+			combine(octave.scale);
+			combine(octave.amplitude);
+		}
+		combine(constant);
+		combine(exponent);
+		combine(offset);
+
+		// The classic table leaves the hash as it was so existing caches stay valid
+		if (table.seed != 0 || table.lattice != noisePermutationLattice)
+		{
+			combineBits(table.seed);
+			combineBits(table.lattice);
+		}
+		return result;
+	}
+
+	// Lowest and highest heights the noise can produce, every noiseValue lies between 0 and 1
+	float minimumHeight() const
+	{
+		return pow(constant, exponent) + offset;
+	}
+
+	float maximumHeight() const
+	{
+		float amplitudeSum = constant;
+		for (const Octave &octave : octaves) amplitudeSum += octave.amplitude;
+		return pow(amplitudeSum, exponent) + offset;
+	}
+};
+
+// Height of the terrain at world coordinate (x, z), the reference for FractalNoise(terrainNoise)
+inline float terrainHeight(float x, float z)
+{
+	return fractalHeight<terrainNoise>(x, z);
+}
+
+// Finds terrainHeight for n points at (x[i], z[i])
+inline void terrainHeightBatch(const float *x, const float *z, float *out, size_t n)
+{
+	fractalHeightBatch<terrainNoise>(x, z, out, n);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+// Alignment of every allocation from a FrameArena, a cache line so allocations never share one
+const size_t arenaAlignment = 64;
+
+/*
+Fixed capacity bump allocator for memory that only lives until the end of a frame.
+The whole capacity is allocated once, each allocation is rounded up to whole cache lines and taken from the end of
+the previous one, and reset frees everything at once, so the render loop never touches the general heap for
+scratch lists. Running out returns NULL rather than growing, which keeps memory use bounded; the largest amount
+ever used is kept so the capacity can be checked against real use.
+*/
+class FrameArena
+{
+public:
+	FrameArena() {}
+
+	~FrameArena()
+	{
+		if (memory) ::operator delete(memory, std::align_val_t(arenaAlignment));
+	}
+
+	FrameArena(const FrameArena &) = delete;
+	FrameArena &operator=(const FrameArena &) = delete;
+
+	void initialise(size_t bytes)
+	{
+		capacityBytes = roundUp(bytes);
+		memory = (uint8_t *)::operator new(capacityBytes, std::align_val_t(arenaAlignment));
+		usedBytes = 0;
+	}
+
+	// Room for count objects of T, which must be trivially destructible as they are never destroyed, or NULL if full
+	template <typename T>
+	T *allocate(size_t count)
+	{
+		static_assert(alignof(T) <= arenaAlignment, "FrameArena allocations are only aligned to a cache line");
+		size_t bytes = roundUp(count * sizeof(T));
+		if (bytes > capacityBytes - usedBytes) return NULL;
+		T *result = (T *)(memory + usedBytes);
+		usedBytes += bytes;
+		if (usedBytes > peakBytes) peakBytes = usedBytes;
+		return result;
+	}
+
+	// Frees every allocation
+	void reset()
+	{
+		usedBytes = 0;
+	}
+
+	size_t capacity() const
+	{
+		return capacityBytes;
+	}
+
+	// Most bytes in use at once since initialise
+	size_t peak() const
+	{
+		return peakBytes;
+	}
+
+private:
+	static size_t roundUp(size_t bytes)
+	{
+		return (bytes + arenaAlignment - 1) & ~(arenaAlignment - 1);
+	}
+
+	uint8_t *memory = NULL;
+	size_t capacityBytes = 0;
+	size_t usedBytes = 0;
+	size_t peakBytes = 0;
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+/*
+Paces the render loop and splits time into fixed simulation steps.
+The camera is moved in steps of simulationTimestep whatever the frame rate, so its speed and paths recorded from it
+don't depend on how fast frames are drawn, and each frame is drawn interpolation of the way between the last two
+steps so motion stays smooth when frames and steps don't line up. Chunk generation is only queued every
+regenerationInterval, so holding a key at a high frame rate doesn't queue a flood of generation work. Time is
+read from a steady clock rather than reset every frame, or advances a fixed amount every frame so benchmarks draw
+the same frames on every run.
+*/
+
+enum PresentMode
+{
+	presentVsync, // Waits for every vertical blank
+	presentAdaptive, // Waits for vertical blanks but tears rather than waiting a whole extra one when a frame is late
+	presentUncapped, // Never waits, frames are only limited by maxFrameRate
+};
+
+const char *const presentModeNames[] = { "vsync", "adaptive", "uncapped" };
+
+// Seconds each simulation step advances the camera by
+const double simulationTimestep = 1.0 / 120.0;
+
+// Steps run in a single frame at most, time beyond them is dropped after a stall rather than catching up
+const int maxSimulationSteps = 8;
+
+// Seconds between queueing generation of the chunks that have come into range
+const double regenerationInterval = 1.0 / 30.0;
+
+// The frame limiter sleeps until this close to the next frame, then spins, as sleeps overshoot
+const double limiterSpinSeconds = 0.002;
+
+class FrameScheduler
+{
+public:
+	/*
+	Sets the swap interval of the current context for mode, which falls back to vsync if adaptive isn't supported.
+	maxFrameRate limits frames per second when above 0. fixedFrameTime, when above 0, is the time every frame
+	advances by instead of the time it really took.
+	*/
+	void initialise(PresentMode mode, double maxFrameRate, double fixedFrameTime)
+	{
+		if (mode == presentAdaptive && !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear")) mode = presentVsync;
+		presentMode = mode;
+		glfwSwapInterval(mode == presentUncapped ? 0 : mode == presentAdaptive ? -1 : 1);
+
+		minimumFrameSeconds = maxFrameRate > 0.0 ? 1.0 / maxFrameRate : 0.0;
+		this->fixedFrameTime = fixedFrameTime;
+		start = std::chrono::steady_clock::now();
+		frameStart = start;
+	}
+
+	// Present mode in use, after any fallback
+	PresentMode mode() const
+	{
+		return presentMode;
+	}
+
+	// Starts a frame, returns the seconds since the last one started
+	double beginFrame()
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		frameSeconds = std::chrono::duration<double>(now - frameStart).count();
+		frameStart = now;
+
+		double advance = fixedFrameTime > 0.0 ? fixedFrameTime : frameSeconds;
+		accumulated = std::min(accumulated + advance, maxSimulationSteps * simulationTimestep);
+		sinceRegeneration += advance;
+		return frameSeconds;
+	}
+
+	// Takes the next simulation step due this frame, false once the remaining time is less than a step
+	bool step()
+	{
+		if (accumulated < simulationTimestep) return false;
+		accumulated -= simulationTimestep;
+		return true;
+	}
+
+	// Fraction of the way from the last step to the next the frame should be drawn at, after every step is taken
+	float interpolation() const
+	{
+		return (float)(accumulated / simulationTimestep);
+	}
+
+	// True at most once a frame, whenever regenerationInterval has passed since it last was
+	bool regenerationDue()
+	{
+		if (sinceRegeneration < regenerationInterval) return false;
+		sinceRegeneration = std::min(sinceRegeneration - regenerationInterval, regenerationInterval);
+		return true;
+	}
+
+	// Waits out the rest of the frame if frames are limited, call before swapping buffers
+	void limit()
+	{
+		if (minimumFrameSeconds <= 0.0) return;
+		std::chrono::steady_clock::time_point end = frameStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(minimumFrameSeconds));
+		std::chrono::steady_clock::duration spin = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(limiterSpinSeconds));
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (end - now > spin) std::this_thread::sleep_for(end - now - spin);
+		while (std::chrono::steady_clock::now() < end)
+		{
+		}
+	}
+
+	// Seconds since initialise
+	double elapsed() const
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+private:
+	PresentMode presentMode = presentVsync;
+	double minimumFrameSeconds = 0.0;
+	double fixedFrameTime = 0.0;
+	std::chrono::steady_clock::time_point start;
+	std::chrono::steady_clock::time_point frameStart;
+	double frameSeconds = 0.0;
+	double accumulated = 0.0;
+	double sinceRegeneration = regenerationInterval;
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+
+#include <glad/glad.h>
+
+#include "fractal_noise.h"
+
+// Must match maxOctaves in the compute shader
+const int gpuMaxOctaves = 16;
+
+/*
+Generates chunk heights with a compute shader (OpenGL 4.3 and above).
+The shader writes straight into the chunk's slot of the ring buffer so no vertex data is uploaded from the CPU.
+*/
+class GpuTerrainGenerator
+{
+public:
+	// Sets up program, built from compute_shader.txt, for noise (and any copy of it with fewer octaves), returns false if the context doesn't support it
+	bool initialise(unsigned int program, const FractalNoise &noise)
+	{
+		if (noise.octaves.size() > gpuMaxOctaves) return false;
+
+		if (!GLAD_GL_VERSION_4_3 || !program) return false;
+		this->program = program;
+
+		// A rebuilt program starts without octaves, so the next generate has to set them whatever was set before
+		currentNoise = NULL;
+		currentCoarser = NULL;
+
+		octaveCellsLocation = glGetUniformLocation(program, "octaveCells");
+		octaveRemaindersLocation = glGetUniformLocation(program, "octaveRemainders");
+		spacingLocation = glGetUniformLocation(program, "spacing");
+		heightRangeLocation = glGetUniformLocation(program, "heightRange");
+		firstVertexLocation = glGetUniformLocation(program, "firstVertex");
+		chunkVertexSizeLocation = glGetUniformLocation(program, "chunkVertexSize");
+		octaveCountLocation = glGetUniformLocation(program, "octaveCount");
+		octavesLocation = glGetUniformLocation(program, "octaves");
+		octaveConstantLocation = glGetUniformLocation(program, "octaveConstant");
+
+		// The shaping is the same for every level so is set once
+		glUseProgram(program);
+		glUniform1f(glGetUniformLocation(program, "exponent"), noise.exponent);
+		glUniform1f(glGetUniformLocation(program, "heightOffset"), noise.offset);
+
+		// Every level shares the noise's seed so its lookup data is uploaded once, the shader reads the table as ints
+		int permutation[512];
+		for (int i = 0; i < 512; i++) permutation[i] = noise.table.permutation[i];
+		if (!permutationBuffer) glGenBuffers(1, &permutationBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, permutationBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(permutation), permutation, GL_STATIC_DRAW);
+
+		float gradients[2 * noiseGradientCount];
+		for (int i = 0; i < noiseGradientCount; i++)
+		{
+			std::memcpy(&gradients[2 * i], &noise.table.gradients[i], sizeof(float));
+			std::memcpy(&gradients[2 * i + 1], &noise.table.gradients[noiseGradientCount + i], sizeof(float));
+		}
+		glUniform1i(glGetUniformLocation(program, "lattice"), (int)noise.table.lattice);
+		glUniform1ui(glGetUniformLocation(program, "hashSeed"), noise.table.hashSeed);
+		glUniform2fv(glGetUniformLocation(program, "gradients"), noiseGradientCount, gradients);
+
+		return true;
+	}
+
+	/*
+	Queues generation of the chunk whose first vertex is at origin, with vertices spacing apart, into
+	vertexBuffer starting at firstVertex. Heights come from noise and blend towards the surface of coarser, or don't
+	blend if it is NULL, and are quantised to 16 bits from heightMinimum to heightMinimum + heightRange. Each vertex
+	is written in the layout of Vertex in chunk_manager.h, normals included.
+	*/
+	void generate(unsigned int vertexBuffer, int firstVertex, NoiseOrigin origin, int spacing, int chunkVertexSize,
+		const FractalNoise &noise, const FractalNoise *coarser, float heightMinimum, float heightRange)
+	{
+		glUseProgram(program);
+		glUniform2f(heightRangeLocation, heightMinimum, heightRange);
+		glUniform1i(spacingLocation, spacing);
+		glUniform1i(firstVertexLocation, firstVertex);
+		glUniform1i(chunkVertexSizeLocation, chunkVertexSize);
+
+		// Chunks are generated a level at a time so the octaves rarely change between dispatches
+		if (&noise != currentNoise || coarser != currentCoarser)
+		{
+			setOctaves(noise, coarser);
+			currentNoise = &noise;
+			currentCoarser = coarser;
+		}
+		setOrigin(origin);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, vertexBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, permutationBuffer);
+
+		int groups = (chunkVertexSize + 7) / 8;
+		glDispatchCompute(groups, groups, 1);
+	}
+
+	// Makes the results of every generate call since the last barrier visible to vertex fetching
+	void finish()
+	{
+		glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+	}
+
+private:
+	// Sets the octaves of the two sets of noise the shader evaluates, an octave count of -1 means there is no coarser set
+	void setOctaves(const FractalNoise &noise, const FractalNoise *coarser)
+	{
+		const FractalNoise *sets[2] = { &noise, coarser };
+		float octaves[2 * gpuMaxOctaves * 2] = {};
+		int counts[2] = { 0, -1 };
+		float constants[2] = { 0.0f, 0.0f };
+		for (int set = 0; set < 2; set++)
+		{
+			if (!sets[set]) continue;
+			counts[set] = (int)sets[set]->octaves.size();
+			constants[set] = sets[set]->constant;
+			for (int i = 0; i < counts[set]; i++)
+			{
+				octaves[2 * (set * gpuMaxOctaves + i)] = 1.0f / sets[set]->octaves[i].scale;
+				octaves[2 * (set * gpuMaxOctaves + i) + 1] = sets[set]->octaves[i].amplitude;
+			}
+		}
+		glUniform1iv(octaveCountLocation, 2, counts);
+		glUniform2fv(octavesLocation, 2 * gpuMaxOctaves, octaves);
+		glUniform1fv(octaveConstantLocation, 2, constants);
+	}
+
+	/*
+	Splits the chunk's origin into lattice cells and remainders for every octave of both sets on the CPU in double
+	precision, so the shader only sees coordinates relative to the chunk, see NoiseOrigin
+	*/
+	void setOrigin(NoiseOrigin origin)
+	{
+		const FractalNoise *sets[2] = { currentNoise, currentCoarser };
+		int cells[2 * gpuMaxOctaves * 2] = {};
+		float remainders[2 * gpuMaxOctaves * 2] = {};
+		for (int set = 0; set < 2; set++)
+		{
+			if (!sets[set]) continue;
+			for (size_t i = 0; i < sets[set]->octaves.size(); i++)
+			{
+				size_t index = 2 * (set * gpuMaxOctaves + i);
+				float frequency = 1.0f / sets[set]->octaves[i].scale;
+				splitOrigin(origin.x, frequency, cells[index], remainders[index]);
+				splitOrigin(origin.z, frequency, cells[index + 1], remainders[index + 1]);
+			}
+		}
+		glUniform2iv(octaveCellsLocation, 2 * gpuMaxOctaves, cells);
+		glUniform2fv(octaveRemaindersLocation, 2 * gpuMaxOctaves, remainders);
+	}
+
+	unsigned int program = 0;
+	unsigned int permutationBuffer = 0;
+	int octaveCellsLocation = -1;
+	int octaveRemaindersLocation = -1;
+	int spacingLocation = -1;
+	int heightRangeLocation = -1;
+	int firstVertexLocation = -1;
+	int chunkVertexSizeLocation = -1;
+	int octaveCountLocation = -1;
+	int octavesLocation = -1;
+	int octaveConstantLocation = -1;
+
+	// Noise whose octaves are currently set in the shader
+	const FractalNoise *currentNoise = NULL;
+	const FractalNoise *currentCoarser = NULL;
+};
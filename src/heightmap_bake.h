@@ -0,0 +1,289 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "fractal_noise.h"
+#include "thread_pool.h"
+#include "tile_codec.h"
+
+/*
+Headless heightmap baking.
+Evaluates the terrain over an arbitrary world rectangle without creating a window or GL context, for example to
+produce collision and pathing data on servers. The rectangle is split into square tiles which are generated in
+parallel on the thread pool and streamed to disk in order.
+
+File layout (little endian):
+	HeightmapHeader
+	tilesX * tilesZ tiles, ordered by tile x then tile z
+	each tile is tileSize * tileSize samples, ordered by x then z like chunk vertices
+
+The packed formats are instead followed by a table of the size in bytes of every tile, as a uint32 each in the
+same order, and then the tiles encoded by encodeTile in tile_codec.h, which starts each with its own height range.
+
+Tiles on the far edges are always full size, samples past width or depth are simply terrain beyond the rectangle.
+Sample (i, j) of the rectangle lies at world position (originX + i * spacing, originZ + j * spacing).
+*/
+
+const char heightmapMagic[4] = { 'P', 'T', 'H', 'M' };
+const uint32_t heightmapVersion = 3;
+
+enum HeightmapFormat : uint32_t
+{
+	heightmapFloat32 = 0,
+	heightmapUint16 = 1, // Quantised linearly between minimumHeight and maximumHeight
+	heightmapPacked16 = 2, // Encoded by tile_codec.h, quantised to 16 bits over each tile's range
+	heightmapPacked12 = 3 // The same quantised to 12 bits
+};
+
+struct HeightmapHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t format;
+	uint32_t tileSize;
+	uint32_t width, depth; // Number of samples along x and z
+	uint32_t tilesX, tilesZ;
+	double originX, originZ;
+	double spacing;
+	uint64_t seed; // Seed the noise was built from, 0 is the classic fixed permutation table
+	float minimumHeight, maximumHeight;
+	uint32_t lattice; // NoiseLattice the noise was built with
+	uint32_t reserved;
+};
+
+// Options read from the command line
+struct BakeSettings
+{
+	std::string outputPath;
+	double originX = 0.0;
+	double originZ = 0.0;
+	uint32_t width = 4096;
+	uint32_t depth = 4096;
+	double spacing = 1.0;
+	uint32_t tileSize = 256;
+	HeightmapFormat format = heightmapFloat32;
+	TileCompression compression = tileUncompressed; // Of packed tiles
+	unsigned int threads = 0;
+	uint64_t seed = 0;
+	NoiseLattice lattice = noisePermutationLattice;
+};
+
+inline bool isPacked(HeightmapFormat format)
+{
+	return format == heightmapPacked16 || format == heightmapPacked12;
+}
+
+// Generates one tile of samples into out, quantising to 16 bits if requested, packed formats are left as floats to encode
+inline void bakeTile(const BakeSettings &settings, const HeightmapHeader &header, const FractalNoise &noise, uint32_t tileX, uint32_t tileZ, char *out)
+{
+	// Samples are found relative to the whole world unit at or before the tile's first sample, as chunks are found
+	// relative to their first vertex, so they are as precise however far the rectangle is from the world's origin
+	const uint32_t tileSize = settings.tileSize;
+	const double firstX = settings.originX + (double)tileX * tileSize * settings.spacing;
+	const double firstZ = settings.originZ + (double)tileZ * tileSize * settings.spacing;
+	const NoiseOrigin origin = { (int64_t)std::floor(firstX), (int64_t)std::floor(firstZ) };
+	std::vector<float> zPositions(tileSize);
+	std::vector<float> heights(tileSize);
+	for (uint32_t j = 0; j < tileSize; j++) zPositions[j] = (float)(firstZ - (double)origin.z + j * settings.spacing);
+
+	float range = header.maximumHeight - header.minimumHeight;
+	for (uint32_t i = 0; i < tileSize; i++)
+	{
+		noise.heightRow(origin, (float)(firstX - (double)origin.x + i * settings.spacing), &zPositions[0], &heights[0], tileSize);
+
+		if (settings.format != heightmapUint16)
+		{
+			std::memcpy(out + (size_t)i * tileSize * sizeof(float), &heights[0], tileSize * sizeof(float));
+		}
+		else
+		{
+			uint16_t *row = (uint16_t *)out + (size_t)i * tileSize;
+			for (uint32_t j = 0; j < tileSize; j++)
+			{
+				float normalised = (heights[j] - header.minimumHeight) / range;
+				if (normalised < 0.0f) normalised = 0.0f;
+				if (normalised > 1.0f) normalised = 1.0f;
+				row[j] = (uint16_t)(normalised * 65535.0f + 0.5f);
+			}
+		}
+	}
+}
+
+// Parses the --bake command line, returns false and prints usage if it is malformed
+inline bool parseBakeSettings(int argc, char *argv[], BakeSettings &settings)
+{
+	int i = 1;
+	if (i < argc && std::string(argv[i]) == "--bake") i++;
+	if (i >= argc) return false;
+	settings.outputPath = argv[i++];
+
+	for (; i < argc; i++)
+	{
+		std::string option = argv[i];
+		bool hasOne = i + 1 < argc;
+		bool hasTwo = i + 2 < argc;
+		if (option == "--origin" && hasTwo)
+		{
+			settings.originX = std::atof(argv[++i]);
+			settings.originZ = std::atof(argv[++i]);
+		}
+		else if (option == "--size" && hasTwo)
+		{
+			settings.width = (uint32_t)std::atol(argv[++i]);
+			settings.depth = (uint32_t)std::atol(argv[++i]);
+		}
+		else if (option == "--spacing" && hasOne) settings.spacing = std::atof(argv[++i]);
+		else if (option == "--tile" && hasOne) settings.tileSize = (uint32_t)std::atol(argv[++i]);
+		else if (option == "--threads" && hasOne) settings.threads = (unsigned int)std::atol(argv[++i]);
+		else if (option == "--seed" && hasOne) settings.seed = std::strtoull(argv[++i], NULL, 10);
+		else if (option == "--hashed-lattice") settings.lattice = noiseHashedLattice;
+		else if (option == "--format" && hasOne)
+		{
+			std::string format = argv[++i];
+			if (format == "float32") settings.format = heightmapFloat32;
+			else if (format == "uint16") settings.format = heightmapUint16;
+			else if (format == "packed16") settings.format = heightmapPacked16;
+			else if (format == "packed12") settings.format = heightmapPacked12;
+			else return false;
+		}
+		else if (option == "--zstd")
+		{
+			settings.compression = tileZstd;
+			if (!tileCompressionSupported(tileZstd)) std::cout << "Built without TILE_CODEC_ZSTD, tiles won't be compressed\n";
+		}
+		else return false;
+	}
+
+	return settings.width > 0 && settings.depth > 0 && settings.tileSize > 0 && settings.spacing > 0.0;
+}
+
+// Entry point for --bake, returns the process exit code
+inline int runBake(int argc, char *argv[])
+{
+	BakeSettings settings;
+	if (!parseBakeSettings(argc, argv, settings))
+	{
+		std::cout << "Usage: --bake <output> [--origin <x> <z>] [--size <width> <depth>] [--spacing <units>]\n"
+			"       [--tile <samples>] [--format float32|uint16|packed16|packed12] [--zstd] [--threads <count>]\n"
+			"       [--seed <seed>] [--hashed-lattice]\n";
+		return 1;
+	}
+
+	FractalNoise noise = FractalNoise(terrainNoise).withSeed(settings.seed, settings.lattice);
+
+	HeightmapHeader header;
+	std::memcpy(header.magic, heightmapMagic, sizeof(header.magic));
+	header.version = heightmapVersion;
+	header.format = settings.format;
+	header.tileSize = settings.tileSize;
+	header.width = settings.width;
+	header.depth = settings.depth;
+	header.tilesX = (settings.width + settings.tileSize - 1) / settings.tileSize;
+	header.tilesZ = (settings.depth + settings.tileSize - 1) / settings.tileSize;
+	header.originX = settings.originX;
+	header.originZ = settings.originZ;
+	header.spacing = settings.spacing;
+	header.seed = settings.seed;
+	header.lattice = settings.lattice;
+	header.reserved = 0;
+	header.minimumHeight = noise.minimumHeight();
+	header.maximumHeight = noise.maximumHeight();
+
+	std::ofstream file(settings.outputPath, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Could not open " << settings.outputPath << '\n';
+		return 1;
+	}
+	file.write((const char *)&header, sizeof(header));
+
+	// The sizes of packed tiles are only known once they are encoded, so their table is filled in at the end
+	const size_t tileCount = (size_t)header.tilesX * header.tilesZ;
+	const bool packed = isPacked(settings.format);
+	std::vector<uint32_t> packedSizes;
+	if (packed)
+	{
+		packedSizes.assign(tileCount, 0);
+		file.write((const char *)&packedSizes[0], tileCount * sizeof(uint32_t));
+	}
+
+	ThreadPool threadPool(settings.threads);
+
+	// Tiles are generated in batches, the next batch is generated while the previous one is written
+	const size_t sampleBytes = settings.format == heightmapUint16 ? sizeof(uint16_t) : sizeof(float);
+	const size_t tileBytes = (size_t)settings.tileSize * settings.tileSize * sampleBytes;
+	const size_t batchSize = 4 * (threadPool.size() + 1);
+	std::vector<char> batches[2] = { std::vector<char>(batchSize * tileBytes), std::vector<char>(batchSize * tileBytes) };
+	std::vector<std::vector<uint8_t>> encoded[2] = { std::vector<std::vector<uint8_t>>(packed ? batchSize : 0), std::vector<std::vector<uint8_t>>(packed ? batchSize : 0) };
+	TaskGroup generation[2];
+	const int packedBits = settings.format == heightmapPacked12 ? 12 : 16;
+
+	auto submitBatch = [&](size_t firstTile, int buffer)
+	{
+		for (size_t tile = firstTile; tile < firstTile + batchSize && tile < tileCount; tile++)
+		{
+			char *out = &batches[buffer][(tile - firstTile) * tileBytes];
+			std::vector<uint8_t> *encodedOut = packed ? &encoded[buffer][tile - firstTile] : NULL;
+			uint32_t tileX = (uint32_t)(tile / header.tilesZ);
+			uint32_t tileZ = (uint32_t)(tile % header.tilesZ);
+			threadPool.submit(generation[buffer], [&settings, &header, &noise, tileX, tileZ, out, encodedOut, packedBits]
+			{
+				bakeTile(settings, header, noise, tileX, tileZ, out);
+				if (!encodedOut) return;
+				encodedOut->clear();
+				encodeTile((const float *)out, (int)settings.tileSize, (int)settings.tileSize, packedBits, settings.compression, *encodedOut);
+			});
+		}
+	};
+
+	auto start = std::chrono::steady_clock::now();
+
+	submitBatch(0, 0);
+	int buffer = 0;
+	for (size_t firstTile = 0; firstTile < tileCount; firstTile += batchSize)
+	{
+		threadPool.wait(generation[buffer]);
+		if (firstTile + batchSize < tileCount) submitBatch(firstTile + batchSize, 1 - buffer);
+
+		size_t tilesInBatch = std::min(batchSize, tileCount - firstTile);
+		if (packed)
+		{
+			for (size_t i = 0; i < tilesInBatch; i++)
+			{
+				const std::vector<uint8_t> &tile = encoded[buffer][i];
+				file.write((const char *)&tile[0], tile.size());
+				packedSizes[firstTile + i] = (uint32_t)tile.size();
+			}
+		}
+		else
+		{
+			file.write(&batches[buffer][0], tilesInBatch * tileBytes);
+		}
+		buffer = 1 - buffer;
+	}
+
+	uint64_t fileBytes = (uint64_t)file.tellp();
+	if (packed)
+	{
+		file.seekp(sizeof(header));
+		file.write((const char *)&packedSizes[0], tileCount * sizeof(uint32_t));
+	}
+	file.close();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double samples = (double)tileCount * settings.tileSize * settings.tileSize;
+
+	std::cout << "Baked " << header.width << "x" << header.depth << " samples in " << tileCount << " tiles to " << settings.outputPath << '\n';
+	std::cout << "Throughput: " << samples / seconds / 1.0e6 << " megasamples/sec (" << seconds << " s, " << threadPool.size() << " worker threads)\n";
+	if (packed) std::cout << "Packed to " << fileBytes * 8.0 / samples << " bits per sample\n";
+	return file ? 0 : 1;
+}
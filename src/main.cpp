@@ -1,4 +1,4 @@
-#include <fstream>
+#include <cstdlib>
 #include <string>
 #include <iostream>
 #include <vector>
@@ -10,15 +10,22 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-// Pre-declaration of noiseValue function
-float noiseValue(float, float);
+#include "camera_path.h"
+#include "frame_scheduler.h"
+#include "chunk_manager.h"
+#include "gpu_generator.h"
+#include "heightmap_bake.h"
+#include "profiler.h"
+#include "shader_manager.h"
+#include "tile_cache.h"
+#include "world_position.h"
 
-// File paths to shaders
-const char *vertexPath = "shaders/vertex_shader.txt";
-const char *fragmentPath = "shaders/fragment_shader.txt";
+// Directory linked shader programs are cached in between runs, next to the executable
+const char *shaderCachePath = "shader_cache";
 
-// Map is square of vertices of side length mapSize
-const unsigned int mapSize = 512;
+// File generated chunks are cached in between runs, next to the executable
+const char *tileCachePath = "terrain_cache.bin";
+const unsigned int tileCacheSlots = 1024;
 
 // Dimensions of glfw window
 const unsigned int windowWidth = 1000;
@@ -26,18 +33,15 @@ const unsigned int windowHeight = 600;
 
 const float fieldView = glm::radians(45.0f);
 const float aspectRatio = (float)windowWidth / (float)windowHeight;
-const float nearPlane = 0.1f;
-const float farPlane = 1000.0f;
+const float nearPlane = 1.0f;
+const float farPlane = 4000.0f;
 
-// Point in 3D space with coordinates (x, y, z)
-struct Vertex
-{
-	float x, y, z;
-};
+// Time the camera advances along the path each frame in benchmark mode, whatever the frame actually took
+const double benchmarkTimestep = 1.0 / 60.0;
 
 struct Camera
 {
-	glm::vec3 position;
+	WorldPosition position;
 	glm::vec3 direction;
 	float yaw; // Angle in radians
 	float pitch; // Angle in radians
@@ -54,29 +58,117 @@ void checkErrors()
 	}
 }
 
-// Loads shader file at given filePath
-std::string loadShaderFile(const char *filePath)
+int main(int argc, char *argv[])
 {
-	std::ifstream shaderFile(filePath);
-	std::string shaderSource((std::istreambuf_iterator<char>(shaderFile)), std::istreambuf_iterator<char>());
-	return shaderSource;
-}
+	// Bakes heightmaps to disk without creating a window
+	if (argc > 1 && std::string(argv[1]) == "--bake") return runBake(argc, argv);
+
+	// Passing --cpu generates terrain on the CPU even when compute shaders are available
+	bool forceCpu = false;
+	bool useTileCache = true;
+	const char *profilePath = NULL;
+
+	// Passing --verify-gpu compares chunks generated by the compute shader with ones generated on the CPU and exits
+	bool verifyGpu = false;
+
+	// Passing --hot-reload rebuilds shaders when their files change, and --no-shader-cache always compiles them
+	bool hotReload = false;
+	bool useShaderCache = true;
+
+	// Passing --present vsync|adaptive|uncapped picks how frames are presented, and --max-fps <rate> limits them
+	PresentMode presentMode = presentVsync;
+	double maxFrameRate = 0.0;
+
+	// Passing --benchmark [seconds] flies along the default path, or the one given with --path, and reports timings
+	bool benchmark = false;
+	double benchmarkSeconds = 0.0;
+	const char *pathPath = NULL;
+	const char *recordPath = NULL;
+
+	// Passing --seed <seed> generates a different world, and --hashed-lattice one that never repeats
+	uint64_t seed = 0;
+	NoiseLattice lattice = noisePermutationLattice;
+
+	// Passing --origin <x> <z> moves the start and any benchmark or recorded path by (x, z) world units
+	double originX = 0.0;
+	double originZ = 0.0;
+
+	// Passing --erosion <iterations> erodes the finest level of detail, which is only done on the CPU
+	ThermalErosion erosion;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string(argv[i]) == "--cpu") forceCpu = true;
+		if (std::string(argv[i]) == "--no-cache") useTileCache = false;
+		if (std::string(argv[i]) == "--verify-gpu") verifyGpu = true;
+		if (std::string(argv[i]) == "--hot-reload") hotReload = true;
+		if (std::string(argv[i]) == "--no-shader-cache") useShaderCache = false;
+		if (std::string(argv[i]) == "--present" && i + 1 < argc)
+		{
+			std::string name = argv[++i];
+			for (int mode = presentVsync; mode <= presentUncapped; mode++)
+			{
+				if (name == presentModeNames[mode]) presentMode = (PresentMode)mode;
+			}
+		}
+		if (std::string(argv[i]) == "--max-fps" && i + 1 < argc) maxFrameRate = std::atof(argv[++i]);
+
+		// Passing --profile <path> also writes the profiler's reports to a CSV file
+		if (std::string(argv[i]) == "--profile" && i + 1 < argc) profilePath = argv[++i];
+
+		if (std::string(argv[i]) == "--benchmark")
+		{
+			benchmark = true;
+			if (i + 1 < argc && std::atof(argv[i + 1]) > 0.0) benchmarkSeconds = std::atof(argv[++i]);
+		}
+		if (std::string(argv[i]) == "--path" && i + 1 < argc) pathPath = argv[++i];
+
+		// Passing --record <path> saves the flight as a path that --benchmark --path can replay
+		if (std::string(argv[i]) == "--record" && i + 1 < argc) recordPath = argv[++i];
+
+		if (std::string(argv[i]) == "--seed" && i + 1 < argc) seed = std::strtoull(argv[++i], NULL, 10);
+		if (std::string(argv[i]) == "--hashed-lattice") lattice = noiseHashedLattice;
+		if (std::string(argv[i]) == "--origin" && i + 2 < argc)
+		{
+			originX = std::atof(argv[++i]);
+			originZ = std::atof(argv[++i]);
+		}
+		if (std::string(argv[i]) == "--erosion" && i + 1 < argc) erosion.iterations = std::atoi(argv[++i]);
+	}
+
+	CameraPath path = CameraPath::scripted();
+	if (pathPath && !path.load(pathPath))
+	{
+		std::cout << "Couldn't load camera path " << pathPath << '\n';
+		return 1;
+	}
+	if (benchmarkSeconds <= 0.0) benchmarkSeconds = path.duration();
+
+	// Chunks cached by an earlier run would make benchmarks depend on what was run before
+	if (benchmark) useTileCache = false;
 
-int main()
-{
 	// Initialise glfw
 	glfwInit();
 
-	// 
-	glfwSwapInterval(1);
-	
-	// Sets version for opengl
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	// Sets version for opengl, 4.3 is needed to generate terrain with compute shaders
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 	// Window object initalisation
 	GLFWwindow *window = glfwCreateWindow(windowWidth, windowHeight, "Perlin Noise", NULL, NULL);
+	if (!window)
+	{
+		// Falls back to a 3.3 context which only supports generating terrain on the CPU
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		window = glfwCreateWindow(windowWidth, windowHeight, "Perlin Noise", NULL, NULL);
+	}
+	if (!window)
+	{
+		std::cout << "Couldn't create a window with an OpenGL 3.3 or 4.3 context\n";
+		glfwTerminate();
+		return 1;
+	}
 	glfwMakeContextCurrent(window);
 	gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
 
@@ -88,86 +180,80 @@ int main()
 	// Background colour
 	glClearColor(0.2f, 0.2f, 0.7f, 1.0f);
 
-	// Initialises vertex array and allocates memory
-	const unsigned int vertexCount = mapSize * mapSize;
-	Vertex *vertices = new Vertex[vertexCount];
-
-	// Index array
-	std::vector<unsigned int> indices;
-
-	for (int i = 0; i < mapSize; i++)
+	// Shaders are read from the shaders directory next to the executable
+	ShaderManager shaders;
+	std::string shaderCacheDirectory = (ShaderManager::executableDirectory(argv[0]) / shaderCachePath).string();
+	shaders.initialise(argv[0], useShaderCache ? shaderCacheDirectory.c_str() : NULL);
+
+	// Shows frame and generation timings in the window title, outlives the chunk manager's workers
+	Profiler profiler;
+	if (!profiler.initialise(profilePath)) std::cout << "Couldn't open " << profilePath << '\n';
+
+	// Worker threads used to generate chunks
+	ThreadPool threadPool;
+
+	// Outlives the chunk manager, whose generation tasks may be writing into it
+	TileCache tileCache;
+
+	// Sets up the shared index buffer used by every chunk
+	ChunkManager chunkManager;
+	FractalNoise noise = FractalNoise(terrainNoise).withSeed(seed, lattice);
+	chunkManager.initialise(threadPool, noise);
+	chunkManager.setProfiler(&profiler);
+	chunkManager.setErosion(erosion);
+	if (erosion.enabled()) std::cout << "Eroding the finest level with " << std::min(erosion.iterations, maxErosionIterations) << " iterations\n";
+
+	// Benchmark runs wait for the chunks each frame needs so every run draws the same frames
+	chunkManager.setSynchronous(benchmark);
+
+	// Generates terrain with a compute shader when the context supports it
+	GpuTerrainGenerator gpuGenerator;
+	int computeProgram = -1;
+	if (!forceCpu && !erosion.enabled() && GLAD_GL_VERSION_4_3) computeProgram = shaders.add({ { GL_COMPUTE_SHADER, "compute_shader.txt" } });
+	bool gpuGeneration = computeProgram >= 0 && gpuGenerator.initialise(shaders.program(computeProgram), noise);
+	if (gpuGeneration)
+	{
+		chunkManager.setGpuGenerator(&gpuGenerator);
+		std::cout << "Generating terrain on the GPU\n";
+	}
+	else
 	{
-		for (int j = 0; j < mapSize; j++)
+		std::cout << "Generating terrain on the CPU\n";
+	}
+	if (verifyGpu)
+	{
+		if (!gpuGeneration)
 		{
-			// Initialises vertices as lattice points along xz plane
-			vertices[mapSize * i + j] = { (float)i, 0.0f, (float)j };
-			if (i < mapSize - 1 && j < mapSize - 1)
-			{
-				/* 
-				Adds the indices for both triangles in the square.
-				Square of v----v
-						  |   /|
-						  |  / |
-						  | /  |
-						  v----v
-				has vertices (clockwise, starting top left) of (i,j),
-				(i, j + 1), (i + 1, j), (i + 1, j + 1). Adds those indices
-				to the vector for each square in the array 
-				*/
-				indices.push_back(mapSize * i + j);
-				indices.push_back(mapSize * i + j + 1);
-				indices.push_back(mapSize * (i + 1) + j);
-				indices.push_back(mapSize * (i + 1) + j);
-				indices.push_back(mapSize * i + j + 1);
-				indices.push_back(mapSize * (i + 1) + j + 1);
-			}
+			std::cout << "GPU generation unavailable, nothing to verify\n";
+			return 1;
 		}
+		GpuComparison comparison = chunkManager.compareGpuGeneration();
+		std::cout << "Compared " << comparison.chunks << " chunks: heights within " << comparison.heightDifference << " (tolerance " << gpuHeightTolerance
+			<< "), normals within " << comparison.normalDifference << " (tolerance " << gpuNormalTolerance << ")\n";
+		return comparison.passed() ? 0 : 1;
+	}
+
+	// Reuses chunks generated on the CPU by previous runs, passing --no-cache always generates them
+	if (useTileCache && tileCache.open((ShaderManager::executableDirectory(argv[0]) / tileCachePath).string(), tileCacheSlots, chunkVertexCount * sizeof(Vertex)))
+	{
+		chunkManager.setTileCache(&tileCache);
 	}
 
-	// Initialises vertex buffer
-	unsigned int vertexBuffer;
-	glGenBuffers(1, &vertexBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertices, GL_DYNAMIC_DRAW);
-
-	// Initialises vertex array
-	unsigned int vertexArray;
-	glGenVertexArrays(1, &vertexArray);
-	glBindVertexArray(vertexArray);
-
-	// Sets up attribute pointer
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
-	glEnableVertexAttribArray(0);
-
-	// Initialises element buffer
-	unsigned int elementBuffer;
-	glGenBuffers(1, &elementBuffer);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-	// Reads in the source code for both shaders
-	std::string vertexSourceString = loadShaderFile(vertexPath);
-	const char *vertexSource = vertexSourceString.c_str();
-	std::string fragmentSourceString = loadShaderFile(fragmentPath);
-	const char *fragmentSource = fragmentSourceString.c_str();
-
-	// Compile shaders
-	unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &vertexSource, NULL);
-	glCompileShader(vertexShader);
-	unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-	glCompileShader(fragmentShader);
-
-	// Initialise program and attach shaders 
-	unsigned int program = glCreateProgram();
-	glAttachShader(program, vertexShader);
-	glAttachShader(program, fragmentShader);
-	glLinkProgram(program);
-
-	// Delete shaders
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	// The terrain's memory is all allocated up front, so is reported once
+	ChunkMemory chunkMemory = chunkManager.memoryUsage();
+	std::cout << "Chunk memory: " << chunkMemory.vertexBuffer / 1024 << " KB vertices, " << chunkMemory.indexBuffer / 1024 << " KB indices, "
+		<< chunkMemory.staging / 1024 << " KB staging, " << chunkMemory.scratch / 1024.0 << " KB scratch\n";
+
+	// Builds the terrain's program, or loads it from the cache
+	int terrainProgram = shaders.add({ { GL_VERTEX_SHADER, "vertex_shader.txt" }, { GL_FRAGMENT_SHADER, "fragment_shader.txt" } });
+	if (terrainProgram < 0) return 1;
+	unsigned int program = shaders.program(terrainProgram);
+	std::cout << "Shaders: " << shaders.compiledCount() << " compiled, " << shaders.cachedCount() << " loaded from cache\n";
+
+	// The frame's uniforms live in a buffer bound once to the program's Frame block, rather than being looked up and set every frame
+	UniformBuffer<FrameUniforms> frameUniforms;
+	frameUniforms.initialise(0);
+	if (!frameUniforms.attach(program, "Frame")) std::cout << "Vertex shader has no Frame uniform block\n";
 
 	glUseProgram(program);
 
@@ -177,227 +263,192 @@ int main()
 
 	glm::mat4 projectionMatrix(1.0f);
 
-	// Sets initial camera position
-	camera.position = glm::vec3(mapSize / 2.0f - 0.5f, 10, mapSize / 2.0f - 0.5);
+	// Camera the projection was last built for, it only changes when the camera turns or changes height
+	float viewYaw = 0.0f;
+	float viewPitch = 0.0f;
+	float viewHeight = 0.0f;
+	bool viewBuilt = false;
+
+	// Sets initial camera position, benchmarks start where their path does
+	camera.position = WorldPosition::fromWorld(originX + 255.5, 10.0, originZ + 255.5);
+	if (benchmark)
+	{
+		CameraKey key = path.sample(0.0);
+		camera.position = WorldPosition::fromWorld(originX + key.position.x, key.position.y, originZ + key.position.z);
+		camera.yaw = key.yaw;
+		camera.pitch = key.pitch;
+	}
+
+	// Camera at the simulation step before camera, each frame is drawn between the two
+	Camera previousCamera = camera;
 
 	checkErrors();
 
-	float xOffset = 0.0f;
-	float zOffset = 0.0f;
+	// Benchmark and recording state
+	double pathTime = 0.0;
+	std::vector<double> frameTimes;
+	CameraPath recording;
+	double nextRecordTime = 0.0;
 
-	bool updateVertices = true;
+	// Benchmarks never wait for vertical sync, which would hide the frame times, and advance a fixed time every frame
+	FrameScheduler scheduler;
+	scheduler.initialise(benchmark ? presentUncapped : presentMode, benchmark ? 0.0 : maxFrameRate, benchmark ? benchmarkTimestep : 0.0);
+	if (!benchmark) std::cout << "Presenting with " << presentModeNames[scheduler.mode()] << '\n';
 
 	// Loop while program is running
-	while (!glfwWindowShouldClose(window))
+	bool pathFinished = false;
+	while (!glfwWindowShouldClose(window) && !pathFinished)
 	{
 		// Clears window
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Time between frames
-		double deltaTime = glfwGetTime();
-		glfwSetTime(0.0);
-
-		float movementSpeed = 10.0f * deltaTime;
+		double deltaTime = scheduler.beginFrame();
+		if (benchmark && pathTime > 0.0) frameTimes.push_back(deltaTime * 1000.0);
 
-		// Move grid values based on keypress to simulate movement in 4 directions (along xz plane)
-		if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-		{
-			xOffset += movementSpeed * glm::cos(glm::radians(camera.yaw));
-			zOffset += movementSpeed * glm::sin(glm::radians(camera.yaw));
-			updateVertices = true;
-		}
-		if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+		// Moves the camera in fixed steps so its speed doesn't depend on the frame rate
+		while (scheduler.step())
 		{
-			xOffset -= movementSpeed * glm::cos(glm::radians(camera.yaw));
-			zOffset -= movementSpeed * glm::sin(glm::radians(camera.yaw));
-			updateVertices = true;
-		}
-		if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-		{
-			xOffset += movementSpeed * glm::cos(glm::radians(camera.yaw - 90.0f));
-			zOffset += movementSpeed * glm::sin(glm::radians(camera.yaw - 90.0f));
-			updateVertices = true;
-		}
-		if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-		{
-			xOffset -= movementSpeed * glm::cos(glm::radians(camera.yaw - 90.0f));
-			zOffset -= movementSpeed * glm::sin(glm::radians(camera.yaw - 90.0f));
-			updateVertices = true;
-		}
-
-		// Moves camera up or down
-		if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) camera.position += glm::vec3(0.0f, movementSpeed, 0.0f);
-		if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) camera.position += glm::vec3(0.0f, -movementSpeed, 0.0f);
+			previousCamera = camera;
+			float movementSpeed = 10.0f * simulationTimestep;
 
-		// Turns camera with arrow keys
-		float turnSpeed = 100.0f * deltaTime;
-		if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) camera.pitch += turnSpeed;
-		if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) camera.pitch -= turnSpeed;
-		if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) camera.yaw += turnSpeed;
-		if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) camera.yaw -= turnSpeed;
+			// Moves camera based on keypress in 4 directions (along xz plane)
+			if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+			{
+				camera.position += movementSpeed * glm::vec3(glm::cos(glm::radians(camera.yaw)), 0.0f, glm::sin(glm::radians(camera.yaw)));
+			}
+			if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+			{
+				camera.position += -movementSpeed * glm::vec3(glm::cos(glm::radians(camera.yaw)), 0.0f, glm::sin(glm::radians(camera.yaw)));
+			}
+			if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+			{
+				camera.position += movementSpeed * glm::vec3(glm::cos(glm::radians(camera.yaw - 90.0f)), 0.0f, glm::sin(glm::radians(camera.yaw - 90.0f)));
+			}
+			if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+			{
+				camera.position += -movementSpeed * glm::vec3(glm::cos(glm::radians(camera.yaw - 90.0f)), 0.0f, glm::sin(glm::radians(camera.yaw - 90.0f)));
+			}
 
-		// Limits camera rotation
-		if (camera.pitch < -89.9f) camera.pitch = -89.9f;
-		if (camera.pitch > 89.9f) camera.pitch = 89.9f;
+			// Moves camera up or down
+			if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) camera.position += glm::vec3(0.0f, movementSpeed, 0.0f);
+			if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) camera.position += glm::vec3(0.0f, -movementSpeed, 0.0f);
 
-		// Calculates normalised direction vector that camera is pointing
-		camera.direction.x = glm::cos(glm::radians(camera.yaw)) * glm::cos(glm::radians(camera.pitch));
-		camera.direction.y = glm::sin(glm::radians(camera.pitch));
-		camera.direction.z = glm::sin(glm::radians(camera.yaw)) * glm::cos(glm::radians(camera.pitch));
-		camera.direction = glm::normalize(camera.direction);
+			// Turns camera with arrow keys
+			float turnSpeed = 100.0f * simulationTimestep;
+			if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) camera.pitch += turnSpeed;
+			if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) camera.pitch -= turnSpeed;
+			if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) camera.yaw += turnSpeed;
+			if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) camera.yaw -= turnSpeed;
 
-		// Calculates projection matrix based on camera vectors
-		glm::vec3 up = glm::normalize(glm::cross(glm::normalize(glm::cross(camera.direction, glm::vec3(0.0f, 1.0f, 0.0f))), camera.direction));
-		projectionMatrix = perspectiveMatrix * glm::lookAt(camera.position, camera.position + camera.direction, up);
+			// Follows the path, as every frame advances the same time every run draws the same frames
+			if (benchmark)
+			{
+				pathTime += simulationTimestep;
+				if (pathTime >= benchmarkSeconds) pathFinished = true;
+				CameraKey key = path.sample(std::min(pathTime, benchmarkSeconds));
+				camera.position = WorldPosition::fromWorld(originX + key.position.x, key.position.y, originZ + key.position.z);
+				camera.yaw = key.yaw;
+				camera.pitch = key.pitch;
+			}
 
-		// Sets projections matrix in shaders
-		glUniformMatrix4fv(glGetUniformLocation(program, "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+			// Limits camera rotation
+			if (camera.pitch < -89.9f) camera.pitch = -89.9f;
+			if (camera.pitch > 89.9f) camera.pitch = 89.9f;
 
-		// Calculates perlin noise values for each coordinate in vertex square
-		if (updateVertices)
-		{
-			for (int i = 0; i < mapSize; i++)
+			if (recordPath && pathTime >= nextRecordTime)
 			{
-				for (int j = 0; j < mapSize; j++)
-				{
-					float xPosition = (float)i + xOffset;
-					float zPosition = (float)j + zOffset;
-
-					// Multiple frequencies are summed to add varying detail
-					float overtone = 64 * noiseValue(xPosition / 256, zPosition / 256);
-					float octave1 = 32 * noiseValue(xPosition / 64, zPosition / 64);
-					float octave2 = 16 * noiseValue(xPosition / 32, zPosition / 32);
-					float octave3 = 8 * noiseValue(xPosition / 16, zPosition / 16);
-					float octave4 = 4 * noiseValue(xPosition / 8, zPosition / 8);
-					float octave5 = 2 * noiseValue(xPosition / 4, zPosition / 4);
-
-					// Sums frequencies and raises to power of 1.2 to add excentuated peaks
-					vertices[i * mapSize + j].y = pow(overtone + octave1 + octave2 + octave3 + octave4 + octave5, 1.2f) - 140;
-				}
+				glm::vec3 position((float)(camera.position.worldX() - originX), camera.position.local.y, (float)(camera.position.worldZ() - originZ));
+				recording.add({ (float)pathTime, position, camera.yaw, camera.pitch });
+				nextRecordTime += cameraPathKeyInterval;
 			}
-			// Adds vertex data to vertex buffer
-			glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertices, GL_DYNAMIC_DRAW);
+			if (recordPath && !benchmark) pathTime += simulationTimestep;
+		}
 
-			updateVertices = false;
+		// Draws the camera between its last two steps
+		float interpolation = scheduler.interpolation();
+		Camera view = previousCamera;
+		view.position += interpolation * previousCamera.position.offsetTo(camera.position);
+		view.yaw = glm::mix(previousCamera.yaw, camera.yaw, interpolation);
+		view.pitch = glm::mix(previousCamera.pitch, camera.pitch, interpolation);
+
+		// The terrain is drawn relative to the camera along x and z, so moving along them leaves the projection as it is
+		if (!viewBuilt || view.yaw != viewYaw || view.pitch != viewPitch || view.position.local.y != viewHeight)
+		{
+			// Calculates normalised direction vector that camera is pointing
+			view.direction.x = glm::cos(glm::radians(view.yaw)) * glm::cos(glm::radians(view.pitch));
+			view.direction.y = glm::sin(glm::radians(view.pitch));
+			view.direction.z = glm::sin(glm::radians(view.yaw)) * glm::cos(glm::radians(view.pitch));
+			view.direction = glm::normalize(view.direction);
+
+			// Calculates projection matrix based on camera vectors
+			glm::vec3 up = glm::normalize(glm::cross(glm::normalize(glm::cross(view.direction, glm::vec3(0.0f, 1.0f, 0.0f))), view.direction));
+			glm::vec3 eye(0.0f, view.position.local.y, 0.0f);
+			projectionMatrix = perspectiveMatrix * glm::lookAt(eye, eye + view.direction, up);
+
+			viewYaw = view.yaw;
+			viewPitch = view.pitch;
+			viewHeight = view.position.local.y;
+			viewBuilt = true;
+		}
+
+		// Programs rebuilt from edited files have none of the old one's state, so it is set up again
+		if (hotReload && shaders.reload(deltaTime))
+		{
+			program = shaders.program(terrainProgram);
+			frameUniforms.attach(program, "Frame");
+			glUseProgram(program);
+			if (gpuGeneration) gpuGenerator.initialise(shaders.program(computeProgram), noise);
+		}
+
+		// Uploads finished chunks every frame but only queues those that have come into view every regenerationInterval,
+		// this may switch to the compute shader's program
+		if (chunkManager.update(view.position, scheduler.regenerationDue())) glUseProgram(program);
+
+		// Draws map, culling chunks out of view
+		{
+			ScopedTimer timer(&profiler, profileDraw);
+			profiler.beginGpu();
+			chunkManager.draw(frameUniforms, projectionMatrix);
+			profiler.endGpu();
 		}
-		// Draws map
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
 
 		checkErrors();
 
-		// Swaps buffers so shown on screen
+		// Swaps buffers so shown on screen, once the frame limit allows
+		scheduler.limit();
 		glfwSwapBuffers(window);
 
 		glfwPollEvents();
 
-		// Outputs framerate to terminal
-		std::cout << 1.0f / deltaTime << '\n';
+		// Shows the latest timings once a second rather than printing every frame
+		if (profiler.endFrame(deltaTime)) glfwSetWindowTitle(window, ("Perlin Noise | " + profiler.summary()).c_str());
 	}
-}
 
-/*
-Perlin noise algorithm from here to EOF.
-Each lattice point is associated with a gradient (as dictated by the permutation table
-and a hash function) and the height of a point is based on the interpolation between
-the gradients of the surrounding lattice points.
-*/
-
-const int permutationTable[512] = {
-	151, 160, 137, 91, 90, 15, 131, 13, 201, 95, 96, 53, 194, 233, 7,
-	225, 140, 36, 103, 30, 69, 142, 8, 99, 37, 240, 21, 10, 23, 190, 6, 148, 247,
-	120, 234, 75, 0, 26, 197, 62, 94, 252, 219, 203, 117, 35, 11, 32, 57, 177, 33,
-	88, 237, 149, 56, 87, 174, 20, 125, 136, 171, 168, 68, 175, 74, 165, 71, 134,
-	139, 48, 27, 166, 77, 146, 158, 231, 83, 111, 229, 122, 60, 211, 133, 230, 220,
-	105, 92, 41, 55, 46, 245, 40, 244, 102, 143, 54, 65, 25, 63, 161, 1, 216, 80,
-	73, 209, 76, 132, 187, 208, 89, 18, 169, 200, 196, 135, 130, 116, 188, 159, 86,
-	164, 100, 109, 198, 173, 186, 3, 64, 52, 217, 226, 250, 124, 123, 5, 202, 38,
-	147, 118, 126, 255, 82, 85, 212, 207, 206, 59, 227, 47, 16, 58, 17, 182, 189,
-	28, 42, 223, 183, 170, 213, 119, 248, 152, 2, 44, 154, 163, 70, 221, 153, 101,
-	155, 167, 43, 172, 9, 129, 22, 39, 253, 19, 98, 108, 110, 79, 113, 224, 232,
-	178, 185, 112, 104, 218, 246, 97, 228, 251, 34, 242, 193, 238, 210, 144, 12,
-	191, 179, 162, 241, 81, 51, 145, 235, 249, 14, 239, 107, 49, 192, 214, 31, 181,
-	199, 106, 157, 184, 84, 204, 176, 115, 121, 50, 45, 127, 4, 150, 254, 138, 236,
-	205, 93, 222, 114, 67, 29, 24, 72, 243, 141, 128, 195, 78, 66, 215, 61, 156, 180,
-	151, 160, 137, 91, 90, 15, 131, 13, 201, 95, 96, 53, 194, 233, 7,
-	225, 140, 36, 103, 30, 69, 142, 8, 99, 37, 240, 21, 10, 23, 190, 6, 148, 247,
-	120, 234, 75, 0, 26, 197, 62, 94, 252, 219, 203, 117, 35, 11, 32, 57, 177, 33,
-	88, 237, 149, 56, 87, 174, 20, 125, 136, 171, 168, 68, 175, 74, 165, 71, 134,
-	139, 48, 27, 166, 77, 146, 158, 231, 83, 111, 229, 122, 60, 211, 133, 230, 220,
-	105, 92, 41, 55, 46, 245, 40, 244, 102, 143, 54, 65, 25, 63, 161, 1, 216, 80,
-	73, 209, 76, 132, 187, 208, 89, 18, 169, 200, 196, 135, 130, 116, 188, 159, 86,
-	164, 100, 109, 198, 173, 186, 3, 64, 52, 217, 226, 250, 124, 123, 5, 202, 38,
-	147, 118, 126, 255, 82, 85, 212, 207, 206, 59, 227, 47, 16, 58, 17, 182, 189,
-	28, 42, 223, 183, 170, 213, 119, 248, 152, 2, 44, 154, 163, 70, 221, 153, 101,
-	155, 167, 43, 172, 9, 129, 22, 39, 253, 19, 98, 108, 110, 79, 113, 224, 232,
-	178, 185, 112, 104, 218, 246, 97, 228, 251, 34, 242, 193, 238, 210, 144, 12,
-	191, 179, 162, 241, 81, 51, 145, 235, 249, 14, 239, 107, 49, 192, 214, 31, 181,
-	199, 106, 157, 184, 84, 204, 176, 115, 121, 50, 45, 127, 4, 150, 254, 138, 236,
-	205, 93, 222, 114, 67, 29, 24, 72, 243, 141, 128, 195, 78, 66, 215, 61, 156, 180,
-};
-
-// Linear interpolation of w between values a and b
-float lerp(float w, float a, float b) {
-	return a * (1.0f - w) + b * w;
-}
+	if (recordPath && !recording.save(recordPath)) std::cout << "Couldn't save camera path " << recordPath << '\n';
 
-// Eases t to reduce artefacts by smoothing transition between values
-float fade(float t)
-{
-	return t * t * t * (t * (t * 6 - 15) + 10);
-}
-
-// Returns dot product of offset of point into square and 1 of 8 direction vectors
-float gradientDotDistance(int hash, float xOffset, float zOffset)
-{
-	switch (hash)
+	if (benchmark)
 	{
-	case 0:
-		return xOffset + zOffset;
-	case 1:
-		return -xOffset + zOffset;
-	case 2:
-		return xOffset -zOffset;
-	case 3:
-		return -xOffset - zOffset;
-	case 4:
-		return xOffset;
-	case 5:
-		return zOffset;
-	case 6:
-		return -xOffset;
-	case 7:
-		return -zOffset;
-	}
-}
-
-// Finds noise value (y value) for point at coordinate (x, z)
-float noiseValue(float x, float z)
-{
-	// gridX and gridZ are between 0 and 255
-	int gridX = (int)floor(x) & 255;
-	int gridZ = (int)floor(z) & 255;
-
-	// Makes x and z integers
-	x -= floor(x);
-	z -= floor(z);
-
-	// Applies easing function to x and z
-	float u = fade(x);
-	float v = fade(z);
-
-	// Gets gradients from permutation table for 4 points of square in which the point lies
-	int gradientBottomLeft = permutationTable[permutationTable[gridX] + gridZ];
-	int gradientBottomRight = permutationTable[permutationTable[gridX + 1] + gridZ];
-	int gradientTopLeft = permutationTable[permutationTable[gridX] + gridZ + 1];
-	int gradientTopRight = permutationTable[permutationTable[gridX + 1] + gridZ + 1];
-
-
-	// Hashes the 4 corners and finds the dot products
-	float dotBottomLeft = gradientDotDistance(gradientBottomLeft & 7, x, z);
-	float dotBottomRight = gradientDotDistance(gradientBottomRight & 7, x - 1.0f, z);
-	float dotTopLeft = gradientDotDistance(gradientTopLeft & 7, x, z - 1.0f);
-	float dotTopRight = gradientDotDistance(gradientTopRight & 7, x - 1.0f, z - 1.0f);
+		const ChunkStatistics &statistics = chunkManager.statistics();
+		double wallSeconds = scheduler.elapsed();
+		double frameCount = (double)std::max<size_t>(frameTimes.size(), 1);
+		double totalMilliseconds = 0.0;
+		double longest = 0.0;
+		for (double time : frameTimes)
+		{
+			totalMilliseconds += time;
+			longest = std::max(longest, time);
+		}
 
-	// Calculation to return noiseValue
-	return 0.5 * lerp(v, lerp(u, dotBottomLeft, dotBottomRight), lerp(u, dotTopLeft, dotTopRight)) + 0.5f;
+		std::cout << "Benchmark: " << frameTimes.size() << " frames, " << benchmarkSeconds << " s of path\n";
+		std::cout << "Frame time (ms): mean " << totalMilliseconds / frameCount << ", p50 " << percentile(frameTimes, 0.5)
+			<< ", p95 " << percentile(frameTimes, 0.95) << ", p99 " << percentile(frameTimes, 0.99) << ", max " << longest << '\n';
+		std::cout << "Chunks generated: " << statistics.chunksGenerated << '\n';
+		std::cout << "Bytes uploaded: " << statistics.bytesUploaded << '\n';
+		std::cout << "Triangles drawn: " << statistics.trianglesDrawn << " (" << statistics.trianglesDrawn / frameCount << " per frame)\n";
+		ChunkMemory memory = chunkManager.memoryUsage();
+		std::cout << "Scratch memory used: " << memory.scratchPeak << " of " << memory.scratch << " bytes\n";
+		std::cout << "Wall time: " << wallSeconds << " s\n";
+	}
+	return 0;
 }
\ No newline at end of file
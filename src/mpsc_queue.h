@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Link embedded in anything that is passed through an MpscQueue
+struct MpscNode
+{
+	std::atomic<MpscNode *> queueNext{ NULL };
+};
+
+/*
+Lock-free intrusive queue with many producers and a single consumer (Vyukov's MPSC queue).
+Pushing is a single atomic exchange so worker threads never block each other, and popping never blocks the
+consumer. Nodes aren't owned or copied, the consumer casts them back to the type they are embedded in.
+*/
+class MpscQueue
+{
+public:
+	MpscQueue()
+		: head(&stub), tail(&stub)
+	{
+	}
+
+	MpscQueue(const MpscQueue &) = delete;
+	MpscQueue &operator=(const MpscQueue &) = delete;
+
+	// Can be called from any thread
+	void push(MpscNode *node)
+	{
+		node->queueNext.store(NULL, std::memory_order_relaxed);
+		MpscNode *previous = head.exchange(node, std::memory_order_acq_rel);
+		previous->queueNext.store(node, std::memory_order_release);
+	}
+
+	/*
+	Returns the oldest node, or NULL if the queue is empty or a push is halfway through, only the consumer thread
+	may call this
+	*/
+	MpscNode *pop()
+	{
+		MpscNode *first = tail;
+		MpscNode *next = first->queueNext.load(std::memory_order_acquire);
+		if (first == &stub)
+		{
+			if (!next) return NULL;
+			tail = next;
+			first = next;
+			next = next->queueNext.load(std::memory_order_acquire);
+		}
+		if (next)
+		{
+			tail = next;
+			return first;
+		}
+
+		// first is the last node, it can only be handed out once the stub is queued behind it
+		if (first != head.load(std::memory_order_acquire)) return NULL;
+		push(&stub);
+		next = first->queueNext.load(std::memory_order_acquire);
+		if (!next) return NULL;
+		tail = next;
+		return first;
+	}
+
+private:
+	std::atomic<MpscNode *> head;
+	MpscNode *tail;
+	MpscNode stub;
+};
@@ -0,0 +1,540 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+Perlin noise algorithm.
+Each lattice point is associated with a gradient (as dictated by the permutation table
+and a hash function) and the height of a point is based on the interpolation between
+the gradients of the surrounding lattice points.
+*/
+
+// Ken Perlin's reference permutation of 0 to 255, used for seed 0 so the classic terrain is unchanged
+const uint8_t classicPermutation[256] = {
+	151, 160, 137, 91, 90, 15, 131, 13, 201, 95, 96, 53, 194, 233, 7,
+	225, 140, 36, 103, 30, 69, 142, 8, 99, 37, 240, 21, 10, 23, 190, 6, 148, 247,
+	120, 234, 75, 0, 26, 197, 62, 94, 252, 219, 203, 117, 35, 11, 32, 57, 177, 33,
+	88, 237, 149, 56, 87, 174, 20, 125, 136, 171, 168, 68, 175, 74, 165, 71, 134,
+	139, 48, 27, 166, 77, 146, 158, 231, 83, 111, 229, 122, 60, 211, 133, 230, 220,
+	105, 92, 41, 55, 46, 245, 40, 244, 102, 143, 54, 65, 25, 63, 161, 1, 216, 80,
+	73, 209, 76, 132, 187, 208, 89, 18, 169, 200, 196, 135, 130, 116, 188, 159, 86,
+	164, 100, 109, 198, 173, 186, 3, 64, 52, 217, 226, 250, 124, 123, 5, 202, 38,
+	147, 118, 126, 255, 82, 85, 212, 207, 206, 59, 227, 47, 16, 58, 17, 182, 189,
+	28, 42, 223, 183, 170, 213, 119, 248, 152, 2, 44, 154, 163, 70, 221, 153, 101,
+	155, 167, 43, 172, 9, 129, 22, 39, 253, 19, 98, 108, 110, 79, 113, 224, 232,
+	178, 185, 112, 104, 218, 246, 97, 228, 251, 34, 242, 193, 238, 210, 144, 12,
+	191, 179, 162, 241, 81, 51, 145, 235, 249, 14, 239, 107, 49, 192, 214, 31, 181,
+	199, 106, 157, 184, 84, 204, 176, 115, 121, 50, 45, 127, 4, 150, 254, 138, 236,
+	205, 93, 222, 114, 67, 29, 24, 72, 243, 141, 128, 195, 78, 66, 215, 61, 156, 180,
+};
+
+// How the gradient of a lattice point is chosen
+enum NoiseLattice : uint32_t
+{
+	// Looked up through a permutation table, so the noise repeats every 256 units, with 8 gradients
+	noisePermutationLattice = 0,
+
+	// Hashed from the lattice point's integer coordinates, so the noise never repeats, with 16 gradients
+	noiseHashedLattice = 1
+};
+
+const int noiseGradientCount = 16;
+
+/*
+Lookup data for one seed of the noise, everything a point needs fits in 12 cache lines so stays in L1.
+Several tables can be used at once to generate independent worlds.
+*/
+struct alignas(64) NoiseTable
+{
+	/*
+	Permutation repeated twice so permutation[permutation[x] + z + 1] never needs wrapping, and padded so vector
+	kernels can gather 4 bytes at a time from any entry
+	*/
+	uint8_t permutation[576];
+
+	// Bits of the gradients of the hashed lattice, x components followed by z components, so they can be gathered
+	int32_t gradients[2 * noiseGradientCount];
+
+	uint64_t seed;
+	NoiseLattice lattice;
+	uint32_t hashSeed; // Seed folded to 32 bits for the hashed lattice
+};
+
+// Shuffles 0 to 255 with the seed, seed 0 gives the classic permutation
+inline NoiseTable buildNoiseTable(uint64_t seed, NoiseLattice lattice = noisePermutationLattice)
+{
+	NoiseTable table = {};
+	table.seed = seed;
+	table.lattice = lattice;
+
+	// splitmix64 stream
+	uint64_t state = seed;
+	auto next = [&state]
+	{
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	};
+
+	uint8_t permutation[256];
+	std::memcpy(permutation, classicPermutation, sizeof(permutation));
+	if (seed != 0)
+	{
+		for (int i = 0; i < 256; i++) permutation[i] = (uint8_t)i;
+		for (int i = 255; i > 0; i--)
+		{
+			int j = (int)(next() % (uint64_t)(i + 1));
+			uint8_t swap = permutation[i];
+			permutation[i] = permutation[j];
+			permutation[j] = swap;
+		}
+	}
+	for (int i = 0; i < 512; i++) table.permutation[i] = permutation[i & 255];
+
+	// Evenly spaced directions, as long as the diagonal gradients so the noise keeps the same range
+	for (int i = 0; i < noiseGradientCount; i++)
+	{
+		float angle = 2.0f * 3.14159265f * i / noiseGradientCount;
+		float x = 1.41421356f * std::cos(angle);
+		float z = 1.41421356f * std::sin(angle);
+		std::memcpy(&table.gradients[i], &x, sizeof(float));
+		std::memcpy(&table.gradients[noiseGradientCount + i], &z, sizeof(float));
+	}
+	table.hashSeed = (uint32_t)(next() >> 32);
+	return table;
+}
+
+// Table of the classic noise, seed 0 with the permutation lattice
+inline const NoiseTable classicNoiseTable = buildNoiseTable(0);
+
+// Part of latticeHash that only depends on x, shared by every lattice point of a column
+inline uint32_t latticeHashColumn(int x)
+{
+	return (uint32_t)x * 0x8DA6B343u;
+}
+
+// latticeHash of the point at z in the column whose part of the hash is column
+inline uint32_t latticeHash(uint32_t column, int z, uint32_t seed)
+{
+	uint32_t hash = column ^ ((uint32_t)z * 0xD8163841u) ^ seed;
+	hash ^= hash >> 15;
+	hash *= 0x2C1B3C6Du;
+	hash ^= hash >> 13;
+	return hash;
+}
+
+// Hash of lattice point (x, z) for the hashed lattice, only uses operations every vector instruction set has
+inline uint32_t latticeHash(int x, int z, uint32_t seed)
+{
+	return latticeHash(latticeHashColumn(x), z, seed);
+}
+
+/*
+Whole lattice cells added to the cell each point lies in, so points can be given relative to a lattice point far
+from the world origin and keep the precision of small floats. The permutation lattice repeats every 256 cells and
+the hashed lattice every 2^32, so offsets wrap around 32 bits.
+*/
+struct LatticeOffset
+{
+	int32_t x, z;
+};
+
+// Adds offset whole cells to cell, wrapping instead of overflowing
+inline int offsetCell(int cell, int32_t offset)
+{
+	return (int)((uint32_t)cell + (uint32_t)offset);
+}
+
+// Linear interpolation of w between values a and b
+inline float lerp(float w, float a, float b) {
+	return a * (1.0f - w) + b * w;
+}
+
+// Eases t to reduce artefacts by smoothing transition between values
+inline float fade(float t)
+{
+	return t * t * t * (t * (t * 6 - 15) + 10);
+}
+
+// Rate of change of fade at t
+inline float fadeDerivative(float t)
+{
+	return 30.0f * t * t * (t * (t - 2.0f) + 1.0f);
+}
+
+// The 8 direction vectors of gradientDotDistance as (x, z), used for the noise's derivatives
+const float permutationGradients[8][2] = {
+	{ 1.0f, 1.0f }, { -1.0f, 1.0f }, { 1.0f, -1.0f }, { -1.0f, -1.0f },
+	{ 1.0f, 0.0f }, { 0.0f, 1.0f }, { -1.0f, 0.0f }, { 0.0f, -1.0f }
+};
+
+// Returns dot product of offset of point into square and 1 of 8 direction vectors, hash must be below 8
+inline float gradientDotDistance(int hash, float xOffset, float zOffset)
+{
+	switch (hash)
+	{
+	case 0:
+		return xOffset + zOffset;
+	case 1:
+		return -xOffset + zOffset;
+	case 2:
+		return xOffset -zOffset;
+	case 3:
+		return -xOffset - zOffset;
+	case 4:
+		return xOffset;
+	case 5:
+		return zOffset;
+	case 6:
+		return -xOffset;
+	default:
+		return -zOffset;
+	}
+}
+
+// Returns dot product of offset of point into square and gradient of the hashed lattice
+inline float hashedGradientDotDistance(const NoiseTable &table, uint32_t hash, float xOffset, float zOffset)
+{
+	int index = (int)(hash >> 28);
+	float gradientX, gradientZ;
+	std::memcpy(&gradientX, &table.gradients[index], sizeof(float));
+	std::memcpy(&gradientZ, &table.gradients[noiseGradientCount + index], sizeof(float));
+	return gradientX * xOffset + gradientZ * zOffset;
+}
+
+/*
+Terms of the noise that only depend on x. Along a row of constant x they are the same for every point, so row
+evaluation finds them once per octave rather than once per point.
+*/
+struct NoiseRow
+{
+	int cellX;
+	float x; // Offset into the cell
+	float u, du; // fade and fadeDerivative of x
+	int left, right; // permutation[gridX] and permutation[gridX + 1] of the permutation lattice
+	uint32_t hashLeft, hashRight; // latticeHashColumn of both columns of the cell for the hashed lattice
+};
+
+// Finds the terms of x, offset cells along, for table
+inline NoiseRow noiseRow(const NoiseTable &table, float x, int32_t offset)
+{
+	NoiseRow row;
+	row.cellX = offsetCell((int)floor(x), offset);
+
+	// Makes x an integer
+	row.x = x - floor(x);
+
+	// Applies easing function to x
+	row.u = fade(row.x);
+	row.du = fadeDerivative(row.x);
+
+	// Only the terms of the table's lattice are found
+	row.left = row.right = 0;
+	row.hashLeft = row.hashRight = 0;
+	if (table.lattice == noiseHashedLattice)
+	{
+		row.hashLeft = latticeHashColumn(row.cellX);
+		row.hashRight = latticeHashColumn(offsetCell(row.cellX, 1));
+	}
+	else
+	{
+		// gridX is between 0 and 255
+		int gridX = row.cellX & 255;
+		row.left = table.permutation[gridX];
+		row.right = table.permutation[gridX + 1];
+	}
+	return row;
+}
+
+// Finds noise value (y value) for the point at z along row, offset cells along, with the lattice and seed of table
+inline float noiseValue(const NoiseTable &table, const NoiseRow &row, float z, int32_t offset)
+{
+	int cellZ = offsetCell((int)floor(z), offset);
+	z -= floor(z);
+	float v = fade(z);
+	float x = row.x;
+	float u = row.u;
+
+	float dotBottomLeft, dotBottomRight, dotTopLeft, dotTopRight;
+	if (table.lattice == noiseHashedLattice)
+	{
+		int cellTop = offsetCell(cellZ, 1);
+		dotBottomLeft = hashedGradientDotDistance(table, latticeHash(row.hashLeft, cellZ, table.hashSeed), x, z);
+		dotBottomRight = hashedGradientDotDistance(table, latticeHash(row.hashRight, cellZ, table.hashSeed), x - 1.0f, z);
+		dotTopLeft = hashedGradientDotDistance(table, latticeHash(row.hashLeft, cellTop, table.hashSeed), x, z - 1.0f);
+		dotTopRight = hashedGradientDotDistance(table, latticeHash(row.hashRight, cellTop, table.hashSeed), x - 1.0f, z - 1.0f);
+	}
+	else
+	{
+		int gridZ = cellZ & 255;
+
+		// Gets gradients from permutation table for 4 points of square in which the point lies
+		const uint8_t *permutation = table.permutation;
+		int gradientBottomLeft = permutation[row.left + gridZ];
+		int gradientBottomRight = permutation[row.right + gridZ];
+		int gradientTopLeft = permutation[row.left + gridZ + 1];
+		int gradientTopRight = permutation[row.right + gridZ + 1];
+
+		// Hashes the 4 corners and finds the dot products
+		dotBottomLeft = gradientDotDistance(gradientBottomLeft & 7, x, z);
+		dotBottomRight = gradientDotDistance(gradientBottomRight & 7, x - 1.0f, z);
+		dotTopLeft = gradientDotDistance(gradientTopLeft & 7, x, z - 1.0f);
+		dotTopRight = gradientDotDistance(gradientTopRight & 7, x - 1.0f, z - 1.0f);
+	}
+
+	// Calculation to return noiseValue
+	return 0.5 * lerp(v, lerp(u, dotBottomLeft, dotBottomRight), lerp(u, dotTopLeft, dotTopRight)) + 0.5f;
+}
+
+// Finds noise value (y value) for point at coordinate (x, z) with the lattice and seed of table, offset cells along
+inline float noiseValue(const NoiseTable &table, float x, float z, LatticeOffset offset = LatticeOffset())
+{
+	return noiseValue(table, noiseRow(table, x, offset.x), z, offset.z);
+}
+
+// Noise value and its rate of change along x and z
+struct NoiseSample
+{
+	float value;
+	float dx, dz;
+};
+
+/*
+Finds noiseValue and its derivatives in one evaluation for the point at z along row. Writing the blend of the four
+corners as a + u(b - a) + v(c - a) + uv(a - b - c + d), where each corner's dot product changes along x and z by
+its gradient and u and v change by fadeDerivative, gives the derivatives from values already found for the height.
+The value is found exactly as noiseValue does.
+*/
+inline NoiseSample noiseValueWithDerivatives(const NoiseTable &table, const NoiseRow &row, float z, int32_t offset)
+{
+	int cellZ = offsetCell((int)floor(z), offset);
+	z -= floor(z);
+	float v = fade(z);
+	float dv = fadeDerivative(z);
+	float x = row.x;
+	float u = row.u;
+	float du = row.du;
+
+	// Dot products and gradients of the corners, bottom left, bottom right, top left then top right
+	float dots[4];
+	float gradientX[4];
+	float gradientZ[4];
+	const float xOffsets[4] = { x, x - 1.0f, x, x - 1.0f };
+	const float zOffsets[4] = { z, z, z - 1.0f, z - 1.0f };
+	for (int corner = 0; corner < 4; corner++)
+	{
+		int cornerZ = offsetCell(cellZ, corner >> 1);
+		if (table.lattice == noiseHashedLattice)
+		{
+			int index = (int)(latticeHash(corner & 1 ? row.hashRight : row.hashLeft, cornerZ, table.hashSeed) >> 28);
+			std::memcpy(&gradientX[corner], &table.gradients[index], sizeof(float));
+			std::memcpy(&gradientZ[corner], &table.gradients[noiseGradientCount + index], sizeof(float));
+			dots[corner] = gradientX[corner] * xOffsets[corner] + gradientZ[corner] * zOffsets[corner];
+		}
+		else
+		{
+			int hash = table.permutation[(corner & 1 ? row.right : row.left) + (cornerZ & 255)] & 7;
+			gradientX[corner] = permutationGradients[hash][0];
+			gradientZ[corner] = permutationGradients[hash][1];
+			dots[corner] = gradientDotDistance(hash, xOffsets[corner], zOffsets[corner]);
+		}
+	}
+
+	NoiseSample sample;
+	sample.value = 0.5 * lerp(v, lerp(u, dots[0], dots[1]), lerp(u, dots[2], dots[3])) + 0.5f;
+
+	float k1 = dots[1] - dots[0];
+	float k2 = dots[2] - dots[0];
+	float k3 = dots[0] - dots[1] - dots[2] + dots[3];
+	float uv = u * v;
+	float gx3 = gradientX[0] - gradientX[1] - gradientX[2] + gradientX[3];
+	float gz3 = gradientZ[0] - gradientZ[1] - gradientZ[2] + gradientZ[3];
+	sample.dx = 0.5f * (gradientX[0] + u * (gradientX[1] - gradientX[0]) + v * (gradientX[2] - gradientX[0]) + uv * gx3 + du * (k1 + k3 * v));
+	sample.dz = 0.5f * (gradientZ[0] + u * (gradientZ[1] - gradientZ[0]) + v * (gradientZ[2] - gradientZ[0]) + uv * gz3 + dv * (k2 + k3 * u));
+	return sample;
+}
+
+inline NoiseSample noiseValueWithDerivatives(const NoiseTable &table, float x, float z, LatticeOffset offset = LatticeOffset())
+{
+	return noiseValueWithDerivatives(table, noiseRow(table, x, offset.x), z, offset.z);
+}
+
+// Finds the classic noise value (y value) for point at coordinate (x, z)
+inline float noiseValue(float x, float z)
+{
+	return noiseValue(classicNoiseTable, x, z);
+}
+
+#include "noise_simd.h"
+
+// Evaluates noiseValue for n points using whichever instruction set the processor supports
+typedef void (*NoiseBatchFunction)(const NoiseTable &table, LatticeOffset offset, const float *x, const float *z, float *out, size_t n);
+
+// Scalar fallback for processors without a vectorised kernel
+inline void noiseValueBatchScalar(const NoiseTable &table, LatticeOffset offset, const float *x, const float *z, float *out, size_t n)
+{
+	for (size_t i = 0; i < n; i++) out[i] = noiseValue(table, x[i], z[i], offset);
+}
+
+// Picks the widest kernel the processor supports
+inline NoiseBatchFunction selectNoiseBatchFunction(const char **name = NULL)
+{
+	const char *unused;
+	if (!name) name = &unused;
+#if NOISE_AVX2
+	if (cpuSupportsAvx2())
+	{
+		*name = "avx2";
+		return noise_avx2::noiseValueBatch;
+	}
+#endif
+#if NOISE_SSE2
+	*name = "sse2";
+	return noise_sse2::noiseValueBatch;
+#elif NOISE_NEON
+	*name = "neon";
+	return noise_neon::noiseValueBatch;
+#else
+	*name = "scalar";
+	return noiseValueBatchScalar;
+#endif
+}
+
+// Name of the instruction set noiseValueBatch runs on
+inline const char *noiseBatchInstructionSet()
+{
+	static const char *name = NULL;
+	if (!name) selectNoiseBatchFunction(&name);
+	return name;
+}
+
+// Finds noise values of table for n points at (x[i], z[i]) offset cells along, the results match noiseValue exactly
+inline void noiseValueBatch(const NoiseTable &table, LatticeOffset offset, const float *x, const float *z, float *out, size_t n)
+{
+	static const NoiseBatchFunction function = selectNoiseBatchFunction();
+	function(table, offset, x, z, out, n);
+}
+
+inline void noiseValueBatch(const NoiseTable &table, const float *x, const float *z, float *out, size_t n)
+{
+	noiseValueBatch(table, LatticeOffset(), x, z, out, n);
+}
+
+// Evaluates noiseValueWithDerivatives for n points, writing the derivatives to dx and dz
+typedef void (*NoiseDerivativesBatchFunction)(const NoiseTable &table, LatticeOffset offset, const float *x, const float *z, float *out, float *dx, float *dz, size_t n);
+
+inline void noiseValueWithDerivativesBatchScalar(const NoiseTable &table, LatticeOffset offset, const float *x, const float *z, float *out, float *dx, float *dz, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		NoiseSample sample = noiseValueWithDerivatives(table, x[i], z[i], offset);
+		out[i] = sample.value;
+		dx[i] = sample.dx;
+		dz[i] = sample.dz;
+	}
+}
+
+inline NoiseDerivativesBatchFunction selectNoiseDerivativesBatchFunction()
+{
+#if NOISE_AVX2
+	if (cpuSupportsAvx2()) return noise_avx2::noiseValueWithDerivativesBatch;
+#endif
+#if NOISE_SSE2
+	return noise_sse2::noiseValueWithDerivativesBatch;
+#elif NOISE_NEON
+	return noise_neon::noiseValueWithDerivativesBatch;
+#else
+	return noiseValueWithDerivativesBatchScalar;
+#endif
+}
+
+// Finds noise values of table and their derivatives for n points, the results match noiseValueWithDerivatives exactly
+inline void noiseValueWithDerivativesBatch(const NoiseTable &table, LatticeOffset offset, const float *x, const float *z, float *out, float *dx, float *dz, size_t n)
+{
+	static const NoiseDerivativesBatchFunction function = selectNoiseDerivativesBatchFunction();
+	function(table, offset, x, z, out, dx, dz, n);
+}
+
+inline void noiseValueWithDerivativesBatch(const NoiseTable &table, const float *x, const float *z, float *out, float *dx, float *dz, size_t n)
+{
+	noiseValueWithDerivativesBatch(table, LatticeOffset(), x, z, out, dx, dz, n);
+}
+
+/*
+Evaluates noiseValue for n points along a row of constant x, at (x, z[i]). The terms that only depend on x are
+found once for the row, so filling a grid a row at a time does less work per point than noiseValueBatch.
+*/
+typedef void (*NoiseRowFunction)(const NoiseTable &table, LatticeOffset offset, float x, const float *z, float *out, size_t n);
+
+inline void noiseValueRowScalar(const NoiseTable &table, LatticeOffset offset, float x, const float *z, float *out, size_t n)
+{
+	NoiseRow row = noiseRow(table, x, offset.x);
+	for (size_t i = 0; i < n; i++) out[i] = noiseValue(table, row, z[i], offset.z);
+}
+
+inline NoiseRowFunction selectNoiseRowFunction()
+{
+#if NOISE_AVX2
+	if (cpuSupportsAvx2()) return noise_avx2::noiseValueRow;
+#endif
+#if NOISE_SSE2
+	return noise_sse2::noiseValueRow;
+#elif NOISE_NEON
+	return noise_neon::noiseValueRow;
+#else
+	return noiseValueRowScalar;
+#endif
+}
+
+// Finds noise values of table for n points at (x, z[i]) offset cells along, the results match noiseValue exactly
+inline void noiseValueRow(const NoiseTable &table, LatticeOffset offset, float x, const float *z, float *out, size_t n)
+{
+	static const NoiseRowFunction function = selectNoiseRowFunction();
+	function(table, offset, x, z, out, n);
+}
+
+// Evaluates noiseValueWithDerivatives for n points along a row of constant x
+typedef void (*NoiseDerivativesRowFunction)(const NoiseTable &table, LatticeOffset offset, float x, const float *z, float *out, float *dx, float *dz, size_t n);
+
+inline void noiseValueWithDerivativesRowScalar(const NoiseTable &table, LatticeOffset offset, float x, const float *z, float *out, float *dx, float *dz, size_t n)
+{
+	NoiseRow row = noiseRow(table, x, offset.x);
+	for (size_t i = 0; i < n; i++)
+	{
+		NoiseSample sample = noiseValueWithDerivatives(table, row, z[i], offset.z);
+		out[i] = sample.value;
+		dx[i] = sample.dx;
+		dz[i] = sample.dz;
+	}
+}
+
+inline NoiseDerivativesRowFunction selectNoiseDerivativesRowFunction()
+{
+#if NOISE_AVX2
+	if (cpuSupportsAvx2()) return noise_avx2::noiseValueWithDerivativesRow;
+#endif
+#if NOISE_SSE2
+	return noise_sse2::noiseValueWithDerivativesRow;
+#elif NOISE_NEON
+	return noise_neon::noiseValueWithDerivativesRow;
+#else
+	return noiseValueWithDerivativesRowScalar;
+#endif
+}
+
+// Finds noise values of table and their derivatives for n points at (x, z[i]), matching noiseValueWithDerivatives exactly
+inline void noiseValueWithDerivativesRow(const NoiseTable &table, LatticeOffset offset, float x, const float *z, float *out, float *dx, float *dz, size_t n)
+{
+	static const NoiseDerivativesRowFunction function = selectNoiseDerivativesRowFunction();
+	function(table, offset, x, z, out, dx, dz, n);
+}
+
+// Finds classic noise values for n points at (x[i], z[i])
+inline void noiseValueBatch(const float *x, const float *z, float *out, size_t n)
+{
+	noiseValueBatch(classicNoiseTable, x, z, out, n);
+}
\ No newline at end of file
@@ -0,0 +1,831 @@
+/*
+Standalone micro-benchmarks for the noise, built separately from the renderer with no OpenGL dependency. Only the
+header only GLM is needed, for the rays of terrain_query.h:
+
+    g++ -std=c++17 -O2 -pthread -I<glm include directory> noise_benchmark.cpp -o noise_benchmark
+
+Measures single point and batched noiseValue throughput, the same with derivatives, evaluating rows of constant x,
+filling fractal heightmaps of several sizes, decoding tiles encoded by tile_codec.h, height queries and raycasts
+through terrain_query.h and how the fill scales with threads. Every result is checked bit for bit against the
+scalar noiseValue and fractalHeight, the kernels also with a lattice offset far from the origin. Before any of
+that, every way of evaluating the terrain is compared with golden heightmaps captured from the scalar
+implementation, to within goldenTolerance.
+
+This is the noise pipeline's regression test. The results are written as CSV (one row per measurement) so they can
+be tracked between builds, and the process exits with 1 if any output didn't match. Passing the CSV of an earlier
+run as a baseline also fails if any result's samples per second dropped by more than the maximum slowdown (a
+fraction, 0.25 by default) from its result there.
+
+    noise_benchmark [--output <path>] [--max-size <samples>] [--max-threads <count>]
+                    [--baseline <path>] [--max-slowdown <fraction>]
+*/
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fractal_noise.h"
+#include "terrain_query.h"
+#include "thread_pool.h"
+#include "tile_codec.h"
+
+// Number of scattered points the point and batch benchmarks evaluate
+const size_t benchmarkPointCount = 1 << 16;
+
+// Side lengths of the square heightmaps filled
+const int heightmapSizes[] = { 256, 512, 1024, 2048, 4096, 8192 };
+
+// Side length of the heightmap filled with each thread count
+const int scalingSize = 2048;
+
+// Every measurement is repeated for at least this long and this many times, the fastest run is reported
+const double minimumBenchmarkSeconds = 0.25;
+const int minimumRepeats = 3;
+
+// Lattice offset the kernels are also checked with, far enough out that wrapping matters for the hashed lattice
+const LatticeOffset farOffset = { 0x7FFFFF00, -0x7FFFFF00 };
+
+// Number of rows, and points along each, the row benchmark evaluates
+const size_t benchmarkRowCount = 256;
+const size_t benchmarkRowLength = benchmarkPointCount / benchmarkRowCount;
+
+// Rows of a heightmap filled by each task
+const int fillRows = 16;
+
+// Side length of the tile of terrain the codec benchmark decodes, the default tile size of --bake
+const int codecTileSize = 256;
+
+// Side of the square of world the height queries are made over, which fits in TerrainQuery's cache
+const int querySize = 512;
+
+// Rays cast in each batch of the raycast benchmark, and the distance along them hits are checked at
+const size_t queryRayCount = 4096;
+const float queryCheckStep = 0.25f;
+
+/*
+Heights of the terrain on a goldenSize by goldenSize grid, captured from the scalar FractalNoise::height when the
+pipeline was known to be right. Every way of evaluating the noise is compared against them, so a change to any of
+them that alters the terrain fails even if the others change with it. The last is sampled far from the origin.
+*/
+const int goldenSize = 8;
+const float goldenStartX = -333.25f, goldenStartZ = -271.75f;
+const float goldenSpacingX = 97.5f, goldenSpacingZ = 83.5f;
+
+// World units golden heights may differ by, as compilers may contract or reorder the float arithmetic
+const float goldenTolerance = 1e-3f;
+
+struct GoldenHeightmap
+{
+	const char *name;
+	uint64_t seed;
+	NoiseLattice lattice;
+	NoiseOrigin origin;
+	float heights[goldenSize * goldenSize]; // Ordered by x then z
+};
+
+const GoldenHeightmap goldenHeightmaps[] = {
+	{ "classic", 0, noisePermutationLattice, { 0, 0 }, {
+		10.4429684f, 20.4722385f, 41.9516716f, 41.0042343f, 3.60582113f, -6.27522469f, 21.8017654f, -28.3490257f,
+		-13.7951574f, 33.9619522f, 37.8037605f, 11.3518467f, -31.3769283f, 37.252903f, 22.4473991f, -9.85143375f,
+		-13.1341095f, -7.62120485f, 5.93638515f, 5.76476383f, -8.31743622f, 14.2338562f, 65.8803101f, 12.1954832f,
+		-6.99250126f, -48.6001587f, -37.4320564f, 19.805378f, 54.2074127f, 32.9289703f, 23.4715214f, -5.95236397f,
+		21.2414818f, -8.67021942f, -60.5474434f, 5.13777828f, 0.222000569f, -2.12902594f, -29.2262554f, -13.5774698f,
+		7.32101154f, 20.845499f, 18.1281967f, -27.6094742f, -49.9983635f, -56.2488594f, -32.4518127f, -34.0513039f,
+		-2.6722939f, 33.940731f, 33.9868927f, 6.69261885f, -29.2656002f, -45.2626915f, 9.61532784f, 36.1284332f,
+		11.0050869f, 41.8839836f, 72.7582016f, -3.12067366f, -1.42247939f, 0.267107248f, 27.0247784f, 63.1123276f
+	} },
+	{ "seeded", 1234, noisePermutationLattice, { 0, 0 }, {
+		8.63092899f, -23.2710571f, -27.4006271f, -0.191641062f, -12.171442f, 19.1366806f, 0.547641039f, 12.9011555f,
+		-1.4520632f, 7.74580908f, -21.2561111f, 24.0468616f, 19.9435253f, -13.1163883f, -16.375349f, 11.4055519f,
+		75.1384735f, 39.1218109f, -8.09095287f, 14.3360538f, 19.0089836f, -19.0028744f, -21.8918266f, -12.8426561f,
+		19.750206f, 3.54351568f, 73.0871658f, -7.67819595f, -12.6981392f, 3.51057363f, 19.2740479f, -28.4696655f,
+		-17.0019188f, -3.07342005f, 15.8415842f, -1.17344868f, -2.54204297f, -3.33307862f, 40.577076f, -5.66881323f,
+		36.4709015f, -18.8890057f, -31.1405468f, -5.89510489f, -10.7221317f, 0.497655541f, 49.4392357f, -10.2628651f,
+		11.2576103f, -16.44907f, -19.951313f, -11.1068888f, 4.974298f, 15.3335552f, 1.12406051f, 9.40613842f,
+		6.83394051f, -33.9424858f, 11.8786421f, -11.9974089f, 5.21011591f, 2.46416545f, -50.1440506f, -18.6513062f
+	} },
+	{ "hashed", 1234, noiseHashedLattice, { 0, 0 }, {
+		43.1329155f, 3.97712779f, -13.1686888f, -46.0802727f, -31.0577984f, -24.3064728f, -14.9236441f, 32.4640541f,
+		18.0686722f, -20.4486217f, -32.6543503f, 3.29500961f, 13.4689026f, -44.315403f, -24.6307507f, 14.1419945f,
+		-34.8425827f, -21.015913f, -2.34309125f, 8.56826496f, 24.5997543f, -34.8395195f, -38.9093819f, -25.6065521f,
+		16.0696259f, 28.2135582f, 33.0166664f, -21.7283974f, -18.0261803f, 26.7752819f, -14.3462524f, -13.6480742f,
+		15.7014437f, 35.6345787f, 23.7892685f, 45.4887428f, 49.306591f, 73.9673691f, 13.4140158f, 9.814291f,
+		39.968338f, 78.7579575f, 83.2010422f, 84.2239532f, 74.4823608f, 85.8370209f, 82.6856842f, 17.9289246f,
+		-3.08239913f, 16.6890125f, 35.9583359f, -5.421422f, 14.6988811f, 49.9284859f, 37.5026627f, -6.86489725f,
+		-40.2880249f, -38.1361122f, -47.6020546f, -27.4756145f, -30.3439636f, 12.661109f, 30.7479992f, -39.5322495f
+	} },
+	{ "far", 0, noisePermutationLattice, { 123456789012ll, -98765432109ll }, {
+		-29.3761044f, -22.0292034f, -0.741835117f, -4.80501366f, 36.7592812f, 10.9100628f, 19.3139515f, -1.6189872f,
+		-25.5188923f, 22.7225666f, 39.3917313f, 6.88531446f, 18.2655487f, 60.9582253f, 48.1945686f, 17.9707928f,
+		-17.2530346f, -6.32514954f, 10.4212637f, 24.3075199f, 15.6731586f, 58.6991692f, 55.4684219f, 59.5403976f,
+		-15.6013918f, -26.9242458f, -13.2046213f, 4.42880344f, 22.6349277f, 26.0754852f, -19.4133186f, 9.21504498f,
+		-5.78373289f, 16.9871521f, 5.79366446f, -35.4487686f, -28.6824894f, -21.2098827f, -37.346756f, -14.6882391f,
+		-42.164341f, -17.1183071f, 44.2708359f, -14.9785423f, -23.0003605f, -55.2993584f, -12.1585169f, 10.568203f,
+		-18.0678024f, 16.3891182f, 44.4469223f, 42.7265396f, -20.5670185f, -18.5659771f, -33.2465057f, 4.80279255f,
+		16.4834118f, 60.9017677f, 70.7053299f, 59.3733406f, 38.4741402f, -0.225304246f, -20.8837814f, -21.9507446f
+	} }
+};
+
+struct BenchmarkSettings
+{
+	const char *outputPath = NULL;
+	int maximumSize = 8192;
+	unsigned int maximumThreads = 0; // 0 uses every hardware thread
+	const char *baselinePath = NULL; // Results of an earlier run to compare throughput against
+	double maximumSlowdown = 0.25; // Fraction of its baseline's throughput a result may lose before it fails
+};
+
+// Throughput of each result of an earlier run, keyed by its benchmark, variant, size and threads
+typedef std::map<std::string, double> BenchmarkBaseline;
+
+// Reads the results of an earlier run from path into baseline, false if it can't be read
+bool readBaseline(const char *path, BenchmarkBaseline &baseline)
+{
+	std::ifstream in(path);
+	if (!in) return false;
+	std::string line;
+	std::getline(in, line);
+	while (std::getline(in, line))
+	{
+		// The key is everything before the seconds, the throughput follows them
+		size_t commas[5];
+		size_t position = 0;
+		int found = 0;
+		for (; found < 5 && (position = line.find(',', position)) != std::string::npos; found++) commas[found] = position++;
+		if (found == 5) baseline[line.substr(0, commas[3])] = std::atof(line.c_str() + commas[4] + 1);
+	}
+	return true;
+}
+
+/*
+Writes results as CSV rows and remembers whether every check passed, and whether any result's throughput fell
+more than maximumSlowdown below its result in the baseline
+*/
+class BenchmarkReport
+{
+public:
+	BenchmarkReport(FILE *file, const BenchmarkBaseline &baseline, double maximumSlowdown)
+		: file(file), baseline(baseline), maximumSlowdown(maximumSlowdown)
+	{
+		std::fprintf(file, "benchmark,variant,size,threads,seconds,samples_per_second,verified\n");
+	}
+
+	void add(const char *benchmark, const std::string &variant, int size, unsigned int threads, double seconds, double samples, bool verified)
+	{
+		double rate = samples / seconds;
+		std::fprintf(file, "%s,%s,%d,%u,%.6f,%.0f,%d\n", benchmark, variant.c_str(), size, threads, seconds, rate, verified ? 1 : 0);
+		std::fflush(file);
+		if (!verified) passed = false;
+
+		auto previous = baseline.find(std::string(benchmark) + "," + variant + "," + std::to_string(size) + "," + std::to_string(threads));
+		if (previous != baseline.end() && rate < previous->second * (1.0 - maximumSlowdown))
+		{
+			std::fprintf(stderr, "%s_%s: %.0f samples/s, baseline %.0f\n", benchmark, variant.c_str(), rate, previous->second);
+			fastEnough = false;
+		}
+	}
+
+	bool passed = true;
+	bool fastEnough = true;
+
+private:
+	FILE *file;
+	BenchmarkBaseline baseline;
+	double maximumSlowdown;
+};
+
+// Runs function until it has taken minimumBenchmarkSeconds and at least minimumRepeats times, returns the fastest run
+template <typename Function>
+double timeFastest(Function function)
+{
+	double fastest = 1e30;
+	double total = 0.0;
+	for (int repeat = 0; repeat < minimumRepeats || total < minimumBenchmarkSeconds; repeat++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		function();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		fastest = std::min(fastest, seconds);
+		total += seconds;
+	}
+	return fastest;
+}
+
+// Whether two arrays of floats are identical bit for bit, reports the first difference
+bool matchesExactly(const char *name, const float *values, const float *expected, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		if (std::memcmp(&values[i], &expected[i], sizeof(float)) != 0)
+		{
+			std::fprintf(stderr, "%s: sample %zu is %.9g, expected %.9g\n", name, i, values[i], expected[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Fills the rows from rowStart to rowEnd of a size by size heightmap with one world unit between samples
+void fillHeightmapRows(float *heightmap, int size, int rowStart, int rowEnd)
+{
+	std::vector<float> xPositions(size);
+	std::vector<float> zPositions(size);
+	for (int j = 0; j < size; j++) zPositions[j] = (float)j;
+	for (int i = rowStart; i < rowEnd; i++)
+	{
+		std::fill(xPositions.begin(), xPositions.end(), (float)i);
+		terrainHeightBatch(&xPositions[0], &zPositions[0], heightmap + (size_t)i * size, size);
+	}
+}
+
+// fillHeightmapRows using FractalNoise::heightRow, which should give exactly the same heights
+void fillHeightmapRowsByRow(float *heightmap, int size, int rowStart, int rowEnd)
+{
+	static const FractalNoise noise(terrainNoise);
+	std::vector<float> zPositions(size);
+	for (int j = 0; j < size; j++) zPositions[j] = (float)j;
+	for (int i = rowStart; i < rowEnd; i++) noise.heightRow(NoiseOrigin(), (float)i, &zPositions[0], heightmap + (size_t)i * size, size);
+}
+
+// Fills a heightmap with threadPool and the calling thread, or only the calling thread if threadPool is NULL
+void fillHeightmap(float *heightmap, int size, ThreadPool *threadPool)
+{
+	if (!threadPool)
+	{
+		fillHeightmapRows(heightmap, size, 0, size);
+		return;
+	}
+
+	TaskGroup fill;
+	for (int row = 0; row < size; row += fillRows)
+	{
+		int rowEnd = std::min(row + fillRows, size);
+		threadPool->submit(fill, [heightmap, size, row, rowEnd] { fillHeightmapRows(heightmap, size, row, rowEnd); });
+	}
+	threadPool->wait(fill);
+}
+
+// Compares rows of a heightmap against fractalHeight, every row if step is 1
+bool verifyHeightmap(const char *name, const float *heightmap, int size, int step)
+{
+	std::vector<float> expected(size);
+	for (int i = 0; i < size; i += step)
+	{
+		for (int j = 0; j < size; j++) expected[j] = terrainHeight((float)i, (float)j);
+		if (!matchesExactly(name, heightmap + (size_t)i * size, &expected[0], size)) return false;
+	}
+	return true;
+}
+
+// Scattered points covering many lattice cells and both signs
+void scatterPoints(std::vector<float> &x, std::vector<float> &z)
+{
+	x.resize(benchmarkPointCount);
+	z.resize(benchmarkPointCount);
+	uint32_t state = 12345;
+	auto next = [&state]
+	{
+		state = state * 1664525u + 1013904223u;
+		return (float)(state >> 8) / (float)(1 << 24) * 4096.0f - 2048.0f;
+	};
+	for (size_t i = 0; i < benchmarkPointCount; i++)
+	{
+		x[i] = next();
+		z[i] = next();
+	}
+}
+
+// Whether values are all within goldenTolerance of the golden heights, reports the first that isn't
+bool matchesGolden(const std::string &name, const float *values, const float *golden, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		if (!(std::fabs(values[i] - golden[i]) <= goldenTolerance))
+		{
+			std::fprintf(stderr, "golden_%s: sample %zu is %.9g, golden %.9g\n", name.c_str(), i, values[i], golden[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+Evaluates every golden heightmap a point at a time, in batches and in rows, with and without derivatives, and
+through the compile time description of the classic terrain, and compares each with the golden heights.
+*/
+void benchmarkGolden(BenchmarkReport &report)
+{
+	const int count = goldenSize * goldenSize;
+	std::vector<float> x(count), z(count), zRow(goldenSize);
+	for (int i = 0; i < goldenSize; i++)
+	{
+		for (int j = 0; j < goldenSize; j++)
+		{
+			x[i * goldenSize + j] = goldenStartX + i * goldenSpacingX;
+			z[i * goldenSize + j] = goldenStartZ + j * goldenSpacingZ;
+		}
+	}
+	for (int j = 0; j < goldenSize; j++) zRow[j] = z[j];
+
+	std::vector<float> out(count), dx(count), dz(count);
+	for (const GoldenHeightmap &golden : goldenHeightmaps)
+	{
+		const FractalNoise noise = FractalNoise(terrainNoise).withSeed(golden.seed, golden.lattice);
+		std::string name = golden.name;
+
+		double seconds = timeFastest([&] { for (int i = 0; i < count; i++) out[i] = noise.height(golden.origin, x[i], z[i]); });
+		report.add("golden", name + "_point", goldenSize, 1, seconds, count, matchesGolden(name + "_point", &out[0], golden.heights, count));
+
+		seconds = timeFastest([&] { noise.heightBatch(golden.origin, &x[0], &z[0], &out[0], count); });
+		report.add("golden", name + "_batch", goldenSize, 1, seconds, count, matchesGolden(name + "_batch", &out[0], golden.heights, count));
+
+		seconds = timeFastest([&] { for (int i = 0; i < goldenSize; i++) noise.heightRow(golden.origin, x[i * goldenSize], &zRow[0], &out[i * goldenSize], goldenSize); });
+		report.add("golden", name + "_row", goldenSize, 1, seconds, count, matchesGolden(name + "_row", &out[0], golden.heights, count));
+
+		seconds = timeFastest([&]
+		{
+			for (int i = 0; i < goldenSize; i++)
+			{
+				size_t start = (size_t)i * goldenSize;
+				noise.heightRowWithDerivatives(golden.origin, x[start], &zRow[0], &out[start], &dx[start], &dz[start], goldenSize);
+			}
+		});
+		report.add("golden", name + "_derivatives_row", goldenSize, 1, seconds, count, matchesGolden(name + "_derivatives_row", &out[0], golden.heights, count));
+
+		if (golden.seed != 0 || golden.origin.x != 0 || golden.origin.z != 0) continue;
+		seconds = timeFastest([&] { for (int i = 0; i < count; i++) out[i] = terrainHeight(x[i], z[i]); });
+		report.add("golden", name + "_fixed_point", goldenSize, 1, seconds, count, matchesGolden(name + "_fixed_point", &out[0], golden.heights, count));
+
+		seconds = timeFastest([&] { terrainHeightBatch(&x[0], &z[0], &out[0], count); });
+		report.add("golden", name + "_fixed_batch", goldenSize, 1, seconds, count, matchesGolden(name + "_fixed_batch", &out[0], golden.heights, count));
+	}
+}
+
+// The classic table, another seed of the permutation lattice and the hashed lattice
+const std::pair<const char *, NoiseTable> benchmarkTables[] = {
+	{ "classic", classicNoiseTable },
+	{ "seeded", buildNoiseTable(1234) },
+	{ "hashed", buildNoiseTable(1234, noiseHashedLattice) }
+};
+
+void benchmarkPoints(BenchmarkReport &report)
+{
+	std::vector<float> x, z;
+	scatterPoints(x, z);
+
+	// Every kernel compiled in and supported by the processor, then whichever noiseValueBatch picks
+	std::vector<std::pair<std::string, NoiseBatchFunction>> kernels;
+	kernels.push_back({ "scalar", noiseValueBatchScalar });
+#if NOISE_SSE2
+	kernels.push_back({ "sse2", noise_sse2::noiseValueBatch });
+#endif
+#if NOISE_AVX2
+	if (cpuSupportsAvx2()) kernels.push_back({ "avx2", noise_avx2::noiseValueBatch });
+#endif
+#if NOISE_NEON
+	kernels.push_back({ "neon", noise_neon::noiseValueBatch });
+#endif
+	kernels.push_back({ std::string("dispatch_") + noiseBatchInstructionSet(), noiseValueBatch });
+
+	std::vector<float> expected(benchmarkPointCount);
+	std::vector<float> expectedFar(benchmarkPointCount);
+	std::vector<float> out(benchmarkPointCount);
+	for (const auto &table : benchmarkTables)
+	{
+		std::string suffix = std::string("_") + table.first;
+		double seconds = timeFastest([&]
+		{
+			for (size_t i = 0; i < benchmarkPointCount; i++) expected[i] = noiseValue(table.second, x[i], z[i]);
+		});
+		report.add("point", "scalar" + suffix, (int)benchmarkPointCount, 1, seconds, (double)benchmarkPointCount, true);
+		for (size_t i = 0; i < benchmarkPointCount; i++) expectedFar[i] = noiseValue(table.second, x[i], z[i], farOffset);
+
+		for (const auto &kernel : kernels)
+		{
+			std::string name = kernel.first + suffix;
+			kernel.second(table.second, farOffset, &x[0], &z[0], &out[0], benchmarkPointCount);
+			bool verified = matchesExactly((name + "_offset").c_str(), &out[0], &expectedFar[0], benchmarkPointCount);
+			seconds = timeFastest([&] { kernel.second(table.second, LatticeOffset(), &x[0], &z[0], &out[0], benchmarkPointCount); });
+			verified = matchesExactly(name.c_str(), &out[0], &expected[0], benchmarkPointCount) && verified;
+			report.add("batch", name, (int)benchmarkPointCount, 1, seconds, (double)benchmarkPointCount, verified);
+		}
+	}
+}
+
+/*
+Throughput of noiseValueWithDerivatives, which costs more than noiseValue but replaces the extra evaluations finite
+differences would need for normals. Values are checked against noiseValue and derivatives against the scalar version.
+*/
+void benchmarkDerivatives(BenchmarkReport &report)
+{
+	std::vector<float> x, z;
+	scatterPoints(x, z);
+
+	std::vector<std::pair<std::string, NoiseDerivativesBatchFunction>> kernels;
+	kernels.push_back({ "scalar", noiseValueWithDerivativesBatchScalar });
+#if NOISE_SSE2
+	kernels.push_back({ "sse2", noise_sse2::noiseValueWithDerivativesBatch });
+#endif
+#if NOISE_AVX2
+	if (cpuSupportsAvx2()) kernels.push_back({ "avx2", noise_avx2::noiseValueWithDerivativesBatch });
+#endif
+#if NOISE_NEON
+	kernels.push_back({ "neon", noise_neon::noiseValueWithDerivativesBatch });
+#endif
+	kernels.push_back({ std::string("dispatch_") + noiseBatchInstructionSet(), noiseValueWithDerivativesBatch });
+
+	std::vector<float> expected(benchmarkPointCount), expectedX(benchmarkPointCount), expectedZ(benchmarkPointCount);
+	std::vector<float> out(benchmarkPointCount), outX(benchmarkPointCount), outZ(benchmarkPointCount);
+	for (const auto &table : benchmarkTables)
+	{
+		std::string suffix = std::string("_") + table.first;
+		std::vector<float> values(benchmarkPointCount);
+		for (size_t i = 0; i < benchmarkPointCount; i++) values[i] = noiseValue(table.second, x[i], z[i]);
+		double seconds = timeFastest([&]
+		{
+			for (size_t i = 0; i < benchmarkPointCount; i++)
+			{
+				NoiseSample sample = noiseValueWithDerivatives(table.second, x[i], z[i]);
+				expected[i] = sample.value;
+				expectedX[i] = sample.dx;
+				expectedZ[i] = sample.dz;
+			}
+		});
+		bool verified = matchesExactly(("derivatives_point" + suffix).c_str(), &expected[0], &values[0], benchmarkPointCount);
+		report.add("derivatives_point", "scalar" + suffix, (int)benchmarkPointCount, 1, seconds, (double)benchmarkPointCount, verified);
+
+		for (const auto &kernel : kernels)
+		{
+			seconds = timeFastest([&] { kernel.second(table.second, LatticeOffset(), &x[0], &z[0], &out[0], &outX[0], &outZ[0], benchmarkPointCount); });
+			std::string name = "derivatives_" + kernel.first + suffix;
+			verified = matchesExactly(name.c_str(), &out[0], &values[0], benchmarkPointCount)
+				&& matchesExactly(name.c_str(), &outX[0], &expectedX[0], benchmarkPointCount)
+				&& matchesExactly(name.c_str(), &outZ[0], &expectedZ[0], benchmarkPointCount);
+			report.add("derivatives_batch", kernel.first + suffix, (int)benchmarkPointCount, 1, seconds, (double)benchmarkPointCount, verified);
+		}
+	}
+}
+
+/*
+Throughput of noiseValueRow and noiseValueWithDerivativesRow, which share the terms of x along each row, over the
+same number of points as the batch benchmarks. Each row is checked against the scalar functions, also offset.
+*/
+void benchmarkRows(BenchmarkReport &report)
+{
+	std::vector<float> x, z;
+	scatterPoints(x, z);
+
+	std::vector<std::pair<std::string, NoiseRowFunction>> kernels;
+	std::vector<std::pair<std::string, NoiseDerivativesRowFunction>> derivativeKernels;
+	kernels.push_back({ "scalar", noiseValueRowScalar });
+	derivativeKernels.push_back({ "scalar", noiseValueWithDerivativesRowScalar });
+#if NOISE_SSE2
+	kernels.push_back({ "sse2", noise_sse2::noiseValueRow });
+	derivativeKernels.push_back({ "sse2", noise_sse2::noiseValueWithDerivativesRow });
+#endif
+#if NOISE_AVX2
+	if (cpuSupportsAvx2())
+	{
+		kernels.push_back({ "avx2", noise_avx2::noiseValueRow });
+		derivativeKernels.push_back({ "avx2", noise_avx2::noiseValueWithDerivativesRow });
+	}
+#endif
+#if NOISE_NEON
+	kernels.push_back({ "neon", noise_neon::noiseValueRow });
+	derivativeKernels.push_back({ "neon", noise_neon::noiseValueWithDerivativesRow });
+#endif
+	std::string dispatch = std::string("dispatch_") + noiseBatchInstructionSet();
+	kernels.push_back({ dispatch, noiseValueRow });
+	derivativeKernels.push_back({ dispatch, noiseValueWithDerivativesRow });
+
+	// Row i lies at x[i] and every row shares the first benchmarkRowLength z
+	std::vector<float> expected(benchmarkPointCount), expectedFar(benchmarkPointCount);
+	std::vector<float> expectedX(benchmarkPointCount), expectedZ(benchmarkPointCount);
+	std::vector<float> out(benchmarkPointCount), outX(benchmarkPointCount), outZ(benchmarkPointCount);
+	for (const auto &table : benchmarkTables)
+	{
+		std::string suffix = std::string("_") + table.first;
+		for (size_t i = 0; i < benchmarkRowCount; i++)
+		{
+			for (size_t j = 0; j < benchmarkRowLength; j++)
+			{
+				size_t index = i * benchmarkRowLength + j;
+				NoiseSample sample = noiseValueWithDerivatives(table.second, x[i], z[j]);
+				expected[index] = sample.value;
+				expectedX[index] = sample.dx;
+				expectedZ[index] = sample.dz;
+				expectedFar[index] = noiseValue(table.second, x[i], z[j], farOffset);
+			}
+		}
+
+		for (const auto &kernel : kernels)
+		{
+			std::string name = "row_" + kernel.first + suffix;
+			for (size_t i = 0; i < benchmarkRowCount; i++) kernel.second(table.second, farOffset, x[i], &z[0], &out[i * benchmarkRowLength], benchmarkRowLength);
+			bool verified = matchesExactly((name + "_offset").c_str(), &out[0], &expectedFar[0], benchmarkPointCount);
+			double seconds = timeFastest([&]
+			{
+				for (size_t i = 0; i < benchmarkRowCount; i++) kernel.second(table.second, LatticeOffset(), x[i], &z[0], &out[i * benchmarkRowLength], benchmarkRowLength);
+			});
+			verified = matchesExactly(name.c_str(), &out[0], &expected[0], benchmarkPointCount) && verified;
+			report.add("row", kernel.first + suffix, (int)benchmarkPointCount, 1, seconds, (double)benchmarkPointCount, verified);
+		}
+
+		for (const auto &kernel : derivativeKernels)
+		{
+			std::string name = "derivatives_row_" + kernel.first + suffix;
+			double seconds = timeFastest([&]
+			{
+				for (size_t i = 0; i < benchmarkRowCount; i++)
+				{
+					size_t start = i * benchmarkRowLength;
+					kernel.second(table.second, LatticeOffset(), x[i], &z[0], &out[start], &outX[start], &outZ[start], benchmarkRowLength);
+				}
+			});
+			bool verified = matchesExactly(name.c_str(), &out[0], &expected[0], benchmarkPointCount)
+				&& matchesExactly(name.c_str(), &outX[0], &expectedX[0], benchmarkPointCount)
+				&& matchesExactly(name.c_str(), &outZ[0], &expectedZ[0], benchmarkPointCount);
+			report.add("derivatives_row", kernel.first + suffix, (int)benchmarkPointCount, 1, seconds, (double)benchmarkPointCount, verified);
+		}
+	}
+}
+
+void benchmarkHeightmaps(BenchmarkReport &report, const BenchmarkSettings &settings)
+{
+	for (int size : heightmapSizes)
+	{
+		if (size > settings.maximumSize) break;
+		std::vector<float> heightmap((size_t)size * size);
+		double seconds = timeFastest([&] { fillHeightmap(&heightmap[0], size, NULL); });
+
+		// Checking every sample of the largest maps against the scalar version would take longer than filling them
+		int step = std::max(1, size / 256);
+		bool verified = verifyHeightmap("heightmap", &heightmap[0], size, step);
+		report.add("heightmap", "terrain", size, 1, seconds, (double)size * size, verified);
+
+		std::fill(heightmap.begin(), heightmap.end(), 0.0f);
+		seconds = timeFastest([&] { fillHeightmapRowsByRow(&heightmap[0], size, 0, size); });
+		verified = verifyHeightmap("heightmap_row", &heightmap[0], size, step);
+		report.add("heightmap", "terrain_row", size, 1, seconds, (double)size * size, verified);
+	}
+}
+
+/*
+Decodes a tile of terrain encoded at each precision, into the 16 bit heights chunks store, to compare with the
+heightmap benchmark generating it. Decoded heights are checked to be within half a quantisation step of the
+originals, and the size of each encoding is printed to stderr.
+*/
+void benchmarkTileCodec(BenchmarkReport &report)
+{
+	const int size = codecTileSize;
+	std::vector<float> heights((size_t)size * size);
+	fillHeightmap(&heights[0], size, NULL);
+	const float lowest = *std::min_element(heights.begin(), heights.end());
+	const float highest = *std::max_element(heights.begin(), heights.end());
+
+	const FractalNoise noise(terrainNoise);
+	const float rangeMinimum = noise.minimumHeight();
+	const float rangeSize = noise.maximumHeight() - noise.minimumHeight();
+
+	std::vector<TileCompression> compressions = { tileUncompressed };
+	if (tileCompressionSupported(tileZstd)) compressions.push_back(tileZstd);
+
+	TileDecoder decoder;
+	std::vector<float> decoded(heights.size());
+	std::vector<uint16_t> normalised(heights.size());
+	for (int bits : { 12, 16 })
+	{
+		for (TileCompression compression : compressions)
+		{
+			std::string variant = std::to_string(bits) + (compression == tileZstd ? "bit_zstd" : "bit");
+			std::vector<uint8_t> encoded;
+			encodeTile(&heights[0], size, size, bits, compression, encoded);
+
+			bool verified = decoder.decodeHeights(&encoded[0], encoded.size(), &decoded[0]);
+			// Half a step, plus the rounding of float arithmetic on heights of this size
+			const float tolerance = 0.5f * (highest - lowest) / ((1 << bits) - 1) + 4.0f * FLT_EPSILON * std::max(std::fabs(lowest), std::fabs(highest));
+			for (size_t i = 0; i < heights.size() && verified; i++)
+			{
+				if (std::fabs(decoded[i] - heights[i]) > tolerance)
+				{
+					std::fprintf(stderr, "tile_decode_%s: sample %zu is %.9g, expected %.9g\n", variant.c_str(), i, decoded[i], heights[i]);
+					verified = false;
+				}
+			}
+
+			double seconds = timeFastest([&] { decoder.decodeNormalised(&encoded[0], encoded.size(), rangeMinimum, rangeSize, &normalised[0], 1); });
+			report.add("tile_decode", variant, size, 1, seconds, (double)size * size, verified);
+			std::fprintf(stderr, "tile_decode_%s: %.2f bits per sample\n", variant.c_str(), encoded.size() * 8.0 / heights.size());
+		}
+	}
+}
+
+/*
+Queries heights at scattered points and casts batches of rays down at the terrain through TerrainQuery, once the
+tiles they need are cached. Heights at lattice points must match the noise exactly, each ray's hit must lie on the
+surface and no sample of the surface before it may be above the ray. The rays are cast again split between threads,
+which must hit in exactly the same places.
+*/
+void benchmarkTerrainQuery(BenchmarkReport &report, const BenchmarkSettings &settings)
+{
+	const FractalNoise noise(terrainNoise);
+	const FractalNoise finest = noise.withoutOctavesFinerThan(2.0f);
+	TerrainQuery query(noise);
+
+	std::vector<double> x(benchmarkPointCount);
+	std::vector<double> z(benchmarkPointCount);
+	uint32_t state = 54321;
+	auto next = [&state]
+	{
+		state = state * 1664525u + 1013904223u;
+		return (double)(state >> 8) / (double)(1 << 24);
+	};
+	for (size_t i = 0; i < benchmarkPointCount; i++)
+	{
+		x[i] = next() * querySize;
+		z[i] = next() * querySize;
+	}
+
+	bool verified = true;
+	for (int i = 0; i <= querySize && verified; i += 7)
+	{
+		for (int j = 0; j <= querySize && verified; j += 5)
+		{
+			int64_t tileX = i / queryTileSize, tileZ = j / queryTileSize;
+			float expected = finest.height({ tileX * queryTileSize, tileZ * queryTileSize }, (float)(i - tileX * queryTileSize), (float)(j - tileZ * queryTileSize));
+			float height = query.height(i, j);
+			if (std::memcmp(&height, &expected, sizeof(float)) != 0)
+			{
+				std::fprintf(stderr, "query_height: height at (%d, %d) is %.9g, expected %.9g\n", i, j, height, expected);
+				verified = false;
+			}
+		}
+	}
+	std::vector<float> heights(benchmarkPointCount);
+	double seconds = timeFastest([&] { for (size_t i = 0; i < benchmarkPointCount; i++) heights[i] = query.height(x[i], z[i]); });
+	report.add("query", "height", querySize, 1, seconds, (double)benchmarkPointCount, verified);
+
+	// Rays from a little above the surface in the middle of the square, pitched between about 15 and 80 degrees
+	// below the horizontal, short enough to stay within the square
+	std::vector<TerrainRay> rays(queryRayCount);
+	for (size_t i = 0; i < queryRayCount; i++)
+	{
+		float angle = (float)(next() * 6.2831853);
+		float pitch = (float)(0.25 + next() * 5.5);
+		double originX = querySize * (0.25 + 0.5 * next());
+		double originZ = querySize * (0.25 + 0.5 * next());
+		rays[i].origin = glm::dvec3(originX, query.height(originX, originZ) + 2.0 + next() * 30.0, originZ);
+		rays[i].direction = glm::normalize(glm::vec3(std::cos(angle), -pitch, std::sin(angle)));
+		rays[i].maxDistance = 0.25f * querySize;
+	}
+	std::vector<TerrainHit> hits(queryRayCount);
+	query.raycast(&rays[0], &hits[0], queryRayCount);
+
+	verified = true;
+	for (size_t i = 0; i < queryRayCount && verified; i++)
+	{
+		const TerrainRay &ray = rays[i];
+		if (hits[i].hit)
+		{
+			glm::dvec3 position = hits[i].position;
+			float above = (float)position.y - query.height(position.x, position.z);
+			if (std::fabs(above) > 0.01f)
+			{
+				std::fprintf(stderr, "query_raycast: ray %zu hit %.9g above the surface\n", i, above);
+				verified = false;
+			}
+		}
+		float end = hits[i].hit ? hits[i].distance - queryCheckStep : ray.maxDistance;
+		for (float t = 0.0f; t < end && verified; t += queryCheckStep)
+		{
+			glm::dvec3 point = ray.origin + glm::dvec3(ray.direction) * (double)t;
+			if (point.y < query.height(point.x, point.z))
+			{
+				std::fprintf(stderr, "query_raycast: ray %zu passed below the surface at %.9g without hitting it first\n", i, t);
+				verified = false;
+			}
+		}
+	}
+	seconds = timeFastest([&] { query.raycast(&rays[0], &hits[0], queryRayCount); });
+	report.add("query", "raycast", querySize, 1, seconds, (double)queryRayCount, verified);
+
+	unsigned int threads = settings.maximumThreads ? settings.maximumThreads : std::max(1u, std::thread::hardware_concurrency());
+	if (threads < 2) return;
+	ThreadPool threadPool(threads - 1);
+	std::vector<TerrainHit> threadedHits(queryRayCount);
+	const size_t batch = queryRayCount / threads + 1;
+	seconds = timeFastest([&]
+	{
+		TaskGroup cast;
+		for (size_t start = 0; start < queryRayCount; start += batch)
+		{
+			size_t count = std::min(batch, queryRayCount - start);
+			threadPool.submit(cast, [&, start, count] { query.raycast(&rays[start], &threadedHits[start], count); });
+		}
+		threadPool.wait(cast);
+	});
+	verified = true;
+	for (size_t i = 0; i < queryRayCount && verified; i++)
+	{
+		if (threadedHits[i].hit != hits[i].hit || threadedHits[i].distance != hits[i].distance)
+		{
+			std::fprintf(stderr, "query_raycast: ray %zu cast on threads hit at %.9g, expected %.9g\n", i, threadedHits[i].distance, hits[i].distance);
+			verified = false;
+		}
+	}
+	report.add("query", "raycast", querySize, threads, seconds, (double)queryRayCount, verified);
+}
+
+void benchmarkThreadScaling(BenchmarkReport &report, const BenchmarkSettings &settings)
+{
+	unsigned int maximumThreads = settings.maximumThreads ? settings.maximumThreads : std::max(1u, std::thread::hardware_concurrency());
+	int size = std::min(scalingSize, settings.maximumSize);
+
+	std::vector<float> reference((size_t)size * size);
+	fillHeightmap(&reference[0], size, NULL);
+
+	// Every count up to 4, then doubling, always ending with the maximum
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < maximumThreads; threads = threads < 4 ? threads + 1 : threads * 2) threadCounts.push_back(threads);
+	threadCounts.push_back(maximumThreads);
+
+	std::vector<float> heightmap((size_t)size * size);
+	for (unsigned int threads : threadCounts)
+	{
+		// The calling thread also runs tasks while it waits, so one fewer worker is needed
+		ThreadPool *threadPool = threads > 1 ? new ThreadPool(threads - 1) : NULL;
+		std::fill(heightmap.begin(), heightmap.end(), 0.0f);
+		double seconds = timeFastest([&] { fillHeightmap(&heightmap[0], size, threadPool); });
+		delete threadPool;
+
+		bool verified = std::memcmp(&heightmap[0], &reference[0], heightmap.size() * sizeof(float)) == 0;
+		report.add("threads", "terrain", size, threads, seconds, (double)size * size, verified);
+	}
+}
+
+// Parses the command line, returns false if it is malformed
+bool parseBenchmarkSettings(int argc, char *argv[], BenchmarkSettings &settings)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+		bool hasOne = i + 1 < argc;
+		if (option == "--output" && hasOne) settings.outputPath = argv[++i];
+		else if (option == "--max-size" && hasOne) settings.maximumSize = std::atoi(argv[++i]);
+		else if (option == "--max-threads" && hasOne) settings.maximumThreads = (unsigned int)std::atoi(argv[++i]);
+		else if (option == "--baseline" && hasOne) settings.baselinePath = argv[++i];
+		else if (option == "--max-slowdown" && hasOne) settings.maximumSlowdown = std::atof(argv[++i]);
+		else return false;
+	}
+	return settings.maximumSize > 0 && settings.maximumSlowdown >= 0.0 && settings.maximumSlowdown < 1.0;
+}
+
+int main(int argc, char *argv[])
+{
+	BenchmarkSettings settings;
+	if (!parseBenchmarkSettings(argc, argv, settings))
+	{
+		std::fprintf(stderr, "Usage: noise_benchmark [--output <path>] [--max-size <samples>] [--max-threads <count>] [--baseline <path>] [--max-slowdown <fraction>]\n");
+		return 1;
+	}
+
+	// Read first as the output may replace it
+	BenchmarkBaseline baseline;
+	if (settings.baselinePath && !readBaseline(settings.baselinePath, baseline))
+	{
+		std::fprintf(stderr, "Could not read %s\n", settings.baselinePath);
+		return 1;
+	}
+
+	FILE *file = settings.outputPath ? std::fopen(settings.outputPath, "w") : stdout;
+	if (!file)
+	{
+		std::fprintf(stderr, "Could not open %s\n", settings.outputPath);
+		return 1;
+	}
+
+	BenchmarkReport report(file, baseline, settings.maximumSlowdown);
+	benchmarkGolden(report);
+	benchmarkPoints(report);
+	benchmarkDerivatives(report);
+	benchmarkRows(report);
+	benchmarkHeightmaps(report, settings);
+	benchmarkTileCodec(report);
+	benchmarkTerrainQuery(report, settings);
+	benchmarkThreadScaling(report, settings);
+
+	if (file != stdout) std::fclose(file);
+	if (!report.passed) std::fprintf(stderr, "Some results didn't match the scalar implementation\n");
+	if (!report.fastEnough) std::fprintf(stderr, "Some results were more than %.0f%% slower than the baseline\n", settings.maximumSlowdown * 100.0);
+	return report.passed && report.fastEnough ? 0 : 1;
+}
@@ -0,0 +1,369 @@
+/*
+Vectorised Perlin noise kernel, included once per instruction set by noise_simd.h.
+The enclosing namespace provides Float, Int, laneCount and the primitive operations. Every step mirrors the
+scalar code in noise.h operation for operation so the results match noiseValue bit for bit.
+*/
+
+// Eases t to reduce artefacts by smoothing transition between values
+inline Float fadeLanes(Float t)
+{
+	return mul(mul(mul(t, t), t), add(mul(t, sub(mul(t, setFloat(6.0f)), setFloat(15.0f))), setFloat(10.0f)));
+}
+
+// Linear interpolation of w between values a and b
+inline Float lerpLanes(Float w, Float a, Float b)
+{
+	return add(mul(a, sub(setFloat(1.0f), w)), mul(b, w));
+}
+
+/*
+Branchless gradientDotDistance for hashes 0 to 7.
+Hashes 0 to 3 use both axes, negating x on bit 0 and z on bit 1. Hashes 4 to 7 use a single axis: even hashes
+keep x, odd hashes keep z, and bit 1 negates whichever is kept.
+*/
+inline Float gradientDotDistanceLanes(Int hash, Float xOffset, Float zOffset)
+{
+	Int signBit = setInt((int)0x80000000u);
+	Int odd = equal(bitAnd(hash, setInt(1)), setInt(1));
+	Int second = equal(bitAnd(hash, setInt(2)), setInt(2));
+	Int singleAxis = equal(bitAnd(hash, setInt(4)), setInt(4));
+
+	Int negateX = bitOr(bitAndNot(singleAxis, odd), bitAnd(singleAxis, second));
+	Int negateZ = second;
+	Int dropX = bitAnd(singleAxis, odd);
+	Int dropZ = bitAndNot(odd, singleAxis);
+
+	Float x = asFloat(bitAndNot(dropX, bitXor(asInt(xOffset), bitAnd(negateX, signBit))));
+	Float z = asFloat(bitAndNot(dropZ, bitXor(asInt(zOffset), bitAnd(negateZ, signBit))));
+	return add(x, z);
+}
+
+// Gradient gradientDotDistanceLanes takes the dot product with, as (gradientX, gradientZ), the same masks applied to 1
+inline void permutationGradientLanes(Int hash, Float &gradientX, Float &gradientZ)
+{
+	Int signBit = setInt((int)0x80000000u);
+	Int odd = equal(bitAnd(hash, setInt(1)), setInt(1));
+	Int second = equal(bitAnd(hash, setInt(2)), setInt(2));
+	Int singleAxis = equal(bitAnd(hash, setInt(4)), setInt(4));
+
+	Int negateX = bitOr(bitAndNot(singleAxis, odd), bitAnd(singleAxis, second));
+	Int negateZ = second;
+	Int dropX = bitAnd(singleAxis, odd);
+	Int dropZ = bitAndNot(odd, singleAxis);
+
+	Int one = asInt(setFloat(1.0f));
+	gradientX = asFloat(bitAndNot(dropX, bitXor(one, bitAnd(negateX, signBit))));
+	gradientZ = asFloat(bitAndNot(dropZ, bitXor(one, bitAnd(negateZ, signBit))));
+}
+
+// Dot product of each lane's offset with the gradient of the hashed lattice chosen by the top 4 bits of hash
+inline Float hashedGradientDotDistanceLanes(const NoiseTable &table, Int hash, Float xOffset, Float zOffset)
+{
+	Int index = shiftRight(hash, 28);
+	Float gradientX = asFloat(gather(table.gradients, index));
+	Float gradientZ = asFloat(gather(table.gradients + noiseGradientCount, index));
+	return add(mul(gradientX, xOffset), mul(gradientZ, zOffset));
+}
+
+// latticeHash for each lane of the point at z in the column whose part of the hash is column
+inline Int latticeHashLanes(Int column, Int z, Int seed)
+{
+	Int hash = bitXor(bitXor(column, mulLow(z, setInt((int)0xD8163841u))), seed);
+	hash = bitXor(hash, shiftRight(hash, 15));
+	hash = mulLow(hash, setInt(0x2C1B3C6D));
+	return bitXor(hash, shiftRight(hash, 13));
+}
+
+// Rate of change of fadeLanes at t
+inline Float fadeDerivativeLanes(Float t)
+{
+	return mul(mul(mul(setFloat(30.0f), t), t), add(mul(t, sub(t, setFloat(2.0f))), setFloat(1.0f)));
+}
+
+// NoiseRow for each lane, where every term that only depends on x is kept
+struct RowTerms
+{
+	Float x, u, du;
+	Int left, right;
+	Int hashLeft, hashRight;
+};
+
+// Finds the terms of x, offset cells along, Lattice must match the table's lattice
+template <NoiseLattice Lattice>
+inline RowTerms rowTermsLanes(const NoiseTable &table, Int offset, Float x)
+{
+	Float floorX = floor(x);
+	Int cellX = add(roundToInt(floorX), offset);
+
+	RowTerms row;
+	row.x = sub(x, floorX);
+	row.u = fadeLanes(row.x);
+	row.du = fadeDerivativeLanes(row.x);
+	row.left = row.right = setInt(0);
+	row.hashLeft = row.hashRight = setInt(0);
+	if (Lattice == noiseHashedLattice)
+	{
+		Int multiplier = setInt((int)0x8DA6B343u);
+		row.hashLeft = mulLow(cellX, multiplier);
+		row.hashRight = mulLow(add(cellX, setInt(1)), multiplier);
+	}
+	else
+	{
+		// gridX is between 0 and 255
+		Int gridX = bitAnd(cellX, setInt(255));
+		row.left = gatherBytes(table.permutation, gridX);
+		row.right = gatherBytes(table.permutation, add(gridX, setInt(1)));
+	}
+	return row;
+}
+
+// Same terms of a single row for every lane, the scalar terms are exactly what rowTermsLanes would find
+inline RowTerms rowTermsLanes(const ::NoiseRow &scalar)
+{
+	RowTerms row;
+	row.x = setFloat(scalar.x);
+	row.u = setFloat(scalar.u);
+	row.du = setFloat(scalar.du);
+	row.left = setInt(scalar.left);
+	row.right = setInt(scalar.right);
+	row.hashLeft = setInt((int)scalar.hashLeft);
+	row.hashRight = setInt((int)scalar.hashRight);
+	return row;
+}
+
+// Finds noise values of table for laneCount points at z along row, Lattice must match the table's lattice
+template <NoiseLattice Lattice>
+inline Float noiseValueLanes(const NoiseTable &table, const RowTerms &row, Int offsetZ, Float z)
+{
+	Float floorZ = floor(z);
+	Int cellZ = add(roundToInt(floorZ), offsetZ);
+	z = sub(z, floorZ);
+	Float v = fadeLanes(z);
+	Float x = row.x;
+	Float u = row.u;
+
+	Float one = setFloat(1.0f);
+	Float dotBottomLeft, dotBottomRight, dotTopLeft, dotTopRight;
+	if (Lattice == noiseHashedLattice)
+	{
+		Int seed = setInt((int)table.hashSeed);
+		Int cellTop = add(cellZ, setInt(1));
+		dotBottomLeft = hashedGradientDotDistanceLanes(table, latticeHashLanes(row.hashLeft, cellZ, seed), x, z);
+		dotBottomRight = hashedGradientDotDistanceLanes(table, latticeHashLanes(row.hashRight, cellZ, seed), sub(x, one), z);
+		dotTopLeft = hashedGradientDotDistanceLanes(table, latticeHashLanes(row.hashLeft, cellTop, seed), x, sub(z, one));
+		dotTopRight = hashedGradientDotDistanceLanes(table, latticeHashLanes(row.hashRight, cellTop, seed), sub(x, one), sub(z, one));
+	}
+	else
+	{
+		// gridZ is between 0 and 255
+		Int gridZ = bitAnd(cellZ, setInt(255));
+
+		// Gets gradients from permutation table for 4 points of square in which each point lies
+		const uint8_t *permutation = table.permutation;
+		Int left = row.left;
+		Int right = row.right;
+		Int gradientBottomLeft = gatherBytes(permutation, add(left, gridZ));
+		Int gradientBottomRight = gatherBytes(permutation, add(right, gridZ));
+		Int gradientTopLeft = gatherBytes(permutation, add(add(left, gridZ), setInt(1)));
+		Int gradientTopRight = gatherBytes(permutation, add(add(right, gridZ), setInt(1)));
+
+		Int seven = setInt(7);
+		dotBottomLeft = gradientDotDistanceLanes(bitAnd(gradientBottomLeft, seven), x, z);
+		dotBottomRight = gradientDotDistanceLanes(bitAnd(gradientBottomRight, seven), sub(x, one), z);
+		dotTopLeft = gradientDotDistanceLanes(bitAnd(gradientTopLeft, seven), x, sub(z, one));
+		dotTopRight = gradientDotDistanceLanes(bitAnd(gradientTopRight, seven), sub(x, one), sub(z, one));
+	}
+
+	Float half = setFloat(0.5f);
+	return add(mul(half, lerpLanes(v, lerpLanes(u, dotBottomLeft, dotBottomRight), lerpLanes(u, dotTopLeft, dotTopRight))), half);
+}
+
+// Finds noise values of table for laneCount points at once offset cells along, Lattice must match the table's lattice
+template <NoiseLattice Lattice>
+inline Float noiseValueLanes(const NoiseTable &table, Int offsetX, Int offsetZ, Float x, Float z)
+{
+	return noiseValueLanes<Lattice>(table, rowTermsLanes<Lattice>(table, offsetX, x), offsetZ, z);
+}
+
+// noiseValueWithDerivatives for laneCount points at z along row, Lattice must match the table's lattice
+template <NoiseLattice Lattice>
+inline void noiseValueWithDerivativesLanes(const NoiseTable &table, const RowTerms &row, Int offsetZ, Float z, Float &value, Float &dx, Float &dz)
+{
+	Float floorZ = floor(z);
+	Int cellZ = add(roundToInt(floorZ), offsetZ);
+	z = sub(z, floorZ);
+	Float v = fadeLanes(z);
+	Float dv = fadeDerivativeLanes(z);
+	Float x = row.x;
+	Float u = row.u;
+	Float du = row.du;
+
+	Float one = setFloat(1.0f);
+	Float dots[4], gradientX[4], gradientZ[4];
+	if (Lattice == noiseHashedLattice)
+	{
+		Int seed = setInt((int)table.hashSeed);
+		Int cellTop = add(cellZ, setInt(1));
+		const Int hashes[4] = {
+			latticeHashLanes(row.hashLeft, cellZ, seed), latticeHashLanes(row.hashRight, cellZ, seed),
+			latticeHashLanes(row.hashLeft, cellTop, seed), latticeHashLanes(row.hashRight, cellTop, seed)
+		};
+		for (int corner = 0; corner < 4; corner++)
+		{
+			Int index = shiftRight(hashes[corner], 28);
+			gradientX[corner] = asFloat(gather(table.gradients, index));
+			gradientZ[corner] = asFloat(gather(table.gradients + noiseGradientCount, index));
+		}
+		dots[0] = add(mul(gradientX[0], x), mul(gradientZ[0], z));
+		dots[1] = add(mul(gradientX[1], sub(x, one)), mul(gradientZ[1], z));
+		dots[2] = add(mul(gradientX[2], x), mul(gradientZ[2], sub(z, one)));
+		dots[3] = add(mul(gradientX[3], sub(x, one)), mul(gradientZ[3], sub(z, one)));
+	}
+	else
+	{
+		Int gridZ = bitAnd(cellZ, setInt(255));
+
+		const uint8_t *permutation = table.permutation;
+		Int left = row.left;
+		Int right = row.right;
+		Int seven = setInt(7);
+		const Int hashes[4] = {
+			bitAnd(gatherBytes(permutation, add(left, gridZ)), seven), bitAnd(gatherBytes(permutation, add(right, gridZ)), seven),
+			bitAnd(gatherBytes(permutation, add(add(left, gridZ), setInt(1))), seven), bitAnd(gatherBytes(permutation, add(add(right, gridZ), setInt(1))), seven)
+		};
+		for (int corner = 0; corner < 4; corner++) permutationGradientLanes(hashes[corner], gradientX[corner], gradientZ[corner]);
+		dots[0] = gradientDotDistanceLanes(hashes[0], x, z);
+		dots[1] = gradientDotDistanceLanes(hashes[1], sub(x, one), z);
+		dots[2] = gradientDotDistanceLanes(hashes[2], x, sub(z, one));
+		dots[3] = gradientDotDistanceLanes(hashes[3], sub(x, one), sub(z, one));
+	}
+
+	Float half = setFloat(0.5f);
+	value = add(mul(half, lerpLanes(v, lerpLanes(u, dots[0], dots[1]), lerpLanes(u, dots[2], dots[3]))), half);
+
+	Float k1 = sub(dots[1], dots[0]);
+	Float k2 = sub(dots[2], dots[0]);
+	Float k3 = add(sub(sub(dots[0], dots[1]), dots[2]), dots[3]);
+	Float uv = mul(u, v);
+	Float gx3 = add(sub(sub(gradientX[0], gradientX[1]), gradientX[2]), gradientX[3]);
+	Float gz3 = add(sub(sub(gradientZ[0], gradientZ[1]), gradientZ[2]), gradientZ[3]);
+	dx = add(add(add(add(gradientX[0], mul(u, sub(gradientX[1], gradientX[0]))), mul(v, sub(gradientX[2], gradientX[0]))), mul(uv, gx3)), mul(du, add(k1, mul(k3, v))));
+	dz = add(add(add(add(gradientZ[0], mul(u, sub(gradientZ[1], gradientZ[0]))), mul(v, sub(gradientZ[2], gradientZ[0]))), mul(uv, gz3)), mul(dv, add(k2, mul(k3, u))));
+	dx = mul(half, dx);
+	dz = mul(half, dz);
+}
+
+// noiseValueWithDerivatives for laneCount points at once, Lattice must match the table's lattice
+template <NoiseLattice Lattice>
+inline void noiseValueWithDerivativesLanes(const NoiseTable &table, Int offsetX, Int offsetZ, Float x, Float z, Float &value, Float &dx, Float &dz)
+{
+	noiseValueWithDerivativesLanes<Lattice>(table, rowTermsLanes<Lattice>(table, offsetX, x), offsetZ, z, value, dx, dz);
+}
+
+template <NoiseLattice Lattice>
+inline void noiseValueWithDerivativesBatchLattice(const NoiseTable &table, LatticeOffset offset, const float *x, const float *z, float *out, float *dx, float *dz, size_t n)
+{
+	Int offsetX = setInt(offset.x);
+	Int offsetZ = setInt(offset.z);
+	size_t i = 0;
+	for (; i + laneCount <= n; i += laneCount)
+	{
+		Float value, derivativeX, derivativeZ;
+		noiseValueWithDerivativesLanes<Lattice>(table, offsetX, offsetZ, loadFloat(x + i), loadFloat(z + i), value, derivativeX, derivativeZ);
+		storeFloat(out + i, value);
+		storeFloat(dx + i, derivativeX);
+		storeFloat(dz + i, derivativeZ);
+	}
+	for (; i < n; i++)
+	{
+		::NoiseSample sample = ::noiseValueWithDerivatives(table, x[i], z[i], offset);
+		out[i] = sample.value;
+		dx[i] = sample.dx;
+		dz[i] = sample.dz;
+	}
+}
+
+// Finds noise values of table and their derivatives for n points, matching noiseValueWithDerivatives exactly
+inline void noiseValueWithDerivativesBatch(const NoiseTable &table, LatticeOffset offset, const float *x, const float *z, float *out, float *dx, float *dz, size_t n)
+{
+	if (table.lattice == noiseHashedLattice) noiseValueWithDerivativesBatchLattice<noiseHashedLattice>(table, offset, x, z, out, dx, dz, n);
+	else noiseValueWithDerivativesBatchLattice<noisePermutationLattice>(table, offset, x, z, out, dx, dz, n);
+}
+
+template <NoiseLattice Lattice>
+inline void noiseValueBatchLattice(const NoiseTable &table, LatticeOffset offset, const float *x, const float *z, float *out, size_t n)
+{
+	Int offsetX = setInt(offset.x);
+	Int offsetZ = setInt(offset.z);
+	size_t i = 0;
+	for (; i + laneCount <= n; i += laneCount)
+	{
+		storeFloat(out + i, noiseValueLanes<Lattice>(table, offsetX, offsetZ, loadFloat(x + i), loadFloat(z + i)));
+	}
+	for (; i < n; i++)
+	{
+		out[i] = ::noiseValue(table, x[i], z[i], offset);
+	}
+}
+
+// Finds noise values of table for n points, any points left over after the last full vector use the scalar version
+inline void noiseValueBatch(const NoiseTable &table, LatticeOffset offset, const float *x, const float *z, float *out, size_t n)
+{
+	if (table.lattice == noiseHashedLattice) noiseValueBatchLattice<noiseHashedLattice>(table, offset, x, z, out, n);
+	else noiseValueBatchLattice<noisePermutationLattice>(table, offset, x, z, out, n);
+}
+
+template <NoiseLattice Lattice>
+inline void noiseValueRowLattice(const NoiseTable &table, LatticeOffset offset, float x, const float *z, float *out, size_t n)
+{
+	::NoiseRow scalarRow = ::noiseRow(table, x, offset.x);
+	RowTerms row = rowTermsLanes(scalarRow);
+	Int offsetZ = setInt(offset.z);
+	size_t i = 0;
+	for (; i + laneCount <= n; i += laneCount)
+	{
+		storeFloat(out + i, noiseValueLanes<Lattice>(table, row, offsetZ, loadFloat(z + i)));
+	}
+	for (; i < n; i++)
+	{
+		out[i] = ::noiseValue(table, scalarRow, z[i], offset.z);
+	}
+}
+
+// Finds noise values of table for n points along the row at x, matching noiseValueBatch with every x the same
+inline void noiseValueRow(const NoiseTable &table, LatticeOffset offset, float x, const float *z, float *out, size_t n)
+{
+	if (table.lattice == noiseHashedLattice) noiseValueRowLattice<noiseHashedLattice>(table, offset, x, z, out, n);
+	else noiseValueRowLattice<noisePermutationLattice>(table, offset, x, z, out, n);
+}
+
+template <NoiseLattice Lattice>
+inline void noiseValueWithDerivativesRowLattice(const NoiseTable &table, LatticeOffset offset, float x, const float *z, float *out, float *dx, float *dz, size_t n)
+{
+	::NoiseRow scalarRow = ::noiseRow(table, x, offset.x);
+	RowTerms row = rowTermsLanes(scalarRow);
+	Int offsetZ = setInt(offset.z);
+	size_t i = 0;
+	for (; i + laneCount <= n; i += laneCount)
+	{
+		Float value, derivativeX, derivativeZ;
+		noiseValueWithDerivativesLanes<Lattice>(table, row, offsetZ, loadFloat(z + i), value, derivativeX, derivativeZ);
+		storeFloat(out + i, value);
+		storeFloat(dx + i, derivativeX);
+		storeFloat(dz + i, derivativeZ);
+	}
+	for (; i < n; i++)
+	{
+		::NoiseSample sample = ::noiseValueWithDerivatives(table, scalarRow, z[i], offset.z);
+		out[i] = sample.value;
+		dx[i] = sample.dx;
+		dz[i] = sample.dz;
+	}
+}
+
+// Finds noise values of table and their derivatives for n points along the row at x
+inline void noiseValueWithDerivativesRow(const NoiseTable &table, LatticeOffset offset, float x, const float *z, float *out, float *dx, float *dz, size_t n)
+{
+	if (table.lattice == noiseHashedLattice) noiseValueWithDerivativesRowLattice<noiseHashedLattice>(table, offset, x, z, out, dx, dz, n);
+	else noiseValueWithDerivativesRowLattice<noisePermutationLattice>(table, offset, x, z, out, dx, dz, n);
+}
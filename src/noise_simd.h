@@ -0,0 +1,204 @@
+#pragma once
+
+/*
+Vectorised versions of noiseValue.
+Each instruction set gets its own namespace declaring a Float and Int vector type, the number of lanes in them
+and the handful of primitive operations the kernel needs. noise_kernel.inl is then included into each namespace
+so there is a single copy of the algorithm which is compiled once per instruction set.
+*/
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NOISE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define NOISE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if NOISE_X86 && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+// SSE2 is part of the x86-64 baseline so needs no runtime check
+namespace noise_sse2
+{
+	typedef __m128 Float;
+	typedef __m128i Int;
+	const int laneCount = 4;
+
+	inline Float loadFloat(const float *p) { return _mm_loadu_ps(p); }
+	inline void storeFloat(float *p, Float a) { _mm_storeu_ps(p, a); }
+	inline Float setFloat(float a) { return _mm_set1_ps(a); }
+	inline Int setInt(int a) { return _mm_set1_epi32(a); }
+	inline Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+	inline Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+	inline Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+	inline Int add(Int a, Int b) { return _mm_add_epi32(a, b); }
+	inline Int bitAnd(Int a, Int b) { return _mm_and_si128(a, b); }
+	inline Int bitAndNot(Int a, Int b) { return _mm_andnot_si128(a, b); } // ~a & b
+	inline Int bitOr(Int a, Int b) { return _mm_or_si128(a, b); }
+	inline Int bitXor(Int a, Int b) { return _mm_xor_si128(a, b); }
+	inline Int equal(Int a, Int b) { return _mm_cmpeq_epi32(a, b); }
+	inline Int asInt(Float a) { return _mm_castps_si128(a); }
+	inline Float asFloat(Int a) { return _mm_castsi128_ps(a); }
+	inline Int roundToInt(Float a) { return _mm_cvtps_epi32(a); }
+
+	// SSE2 has no floor instruction so truncates and corrects values that were rounded up
+	inline Float floor(Float a)
+	{
+		Float truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+		return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, a), _mm_set1_ps(1.0f)));
+	}
+
+	inline Int shiftRight(Int a, int count) { return _mm_srl_epi32(a, _mm_cvtsi32_si128(count)); }
+
+	// SSE2 only multiplies even lanes into 64 bits, so multiplies the odd lanes separately and interleaves the low halves
+	inline Int mulLow(Int a, Int b)
+	{
+		Int even = _mm_mul_epu32(a, b);
+		Int odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+		return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+	}
+
+	// SSE2 has no gather instruction so looks each lane up separately
+	inline Int gather(const int32_t *table, Int index)
+	{
+		alignas(16) int lanes[4];
+		_mm_store_si128((__m128i *)lanes, index);
+		return _mm_setr_epi32(table[lanes[0]], table[lanes[1]], table[lanes[2]], table[lanes[3]]);
+	}
+
+	inline Int gatherBytes(const uint8_t *table, Int index)
+	{
+		alignas(16) int lanes[4];
+		_mm_store_si128((__m128i *)lanes, index);
+		return _mm_setr_epi32(table[lanes[0]], table[lanes[1]], table[lanes[2]], table[lanes[3]]);
+	}
+
+#include "noise_kernel.inl"
+}
+#define NOISE_SSE2 1
+#endif
+
+#if NOISE_X86
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+namespace noise_avx2
+{
+	typedef __m256 Float;
+	typedef __m256i Int;
+	const int laneCount = 8;
+
+	inline Float loadFloat(const float *p) { return _mm256_loadu_ps(p); }
+	inline void storeFloat(float *p, Float a) { _mm256_storeu_ps(p, a); }
+	inline Float setFloat(float a) { return _mm256_set1_ps(a); }
+	inline Int setInt(int a) { return _mm256_set1_epi32(a); }
+	inline Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+	inline Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+	inline Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+	inline Int add(Int a, Int b) { return _mm256_add_epi32(a, b); }
+	inline Int bitAnd(Int a, Int b) { return _mm256_and_si256(a, b); }
+	inline Int bitAndNot(Int a, Int b) { return _mm256_andnot_si256(a, b); } // ~a & b
+	inline Int bitOr(Int a, Int b) { return _mm256_or_si256(a, b); }
+	inline Int bitXor(Int a, Int b) { return _mm256_xor_si256(a, b); }
+	inline Int equal(Int a, Int b) { return _mm256_cmpeq_epi32(a, b); }
+	inline Int asInt(Float a) { return _mm256_castps_si256(a); }
+	inline Float asFloat(Int a) { return _mm256_castsi256_ps(a); }
+	inline Int roundToInt(Float a) { return _mm256_cvtps_epi32(a); }
+	inline Float floor(Float a) { return _mm256_floor_ps(a); }
+	inline Int shiftRight(Int a, int count) { return _mm256_srl_epi32(a, _mm_cvtsi32_si128(count)); }
+	inline Int mulLow(Int a, Int b) { return _mm256_mullo_epi32(a, b); }
+	inline Int gather(const int32_t *table, Int index) { return _mm256_i32gather_epi32((const int *)table, index, 4); }
+
+	// Gathers the 4 bytes starting at each entry and keeps the first, the table is padded so this stays inside it
+	inline Int gatherBytes(const uint8_t *table, Int index)
+	{
+		return _mm256_and_si256(_mm256_i32gather_epi32((const int *)table, index, 1), _mm256_set1_epi32(255));
+	}
+
+#include "noise_kernel.inl"
+}
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+#define NOISE_AVX2 1
+#endif
+
+#if NOISE_NEON
+// NEON is always present on 64-bit ARM
+namespace noise_neon
+{
+	typedef float32x4_t Float;
+	typedef int32x4_t Int;
+	const int laneCount = 4;
+
+	inline Float loadFloat(const float *p) { return vld1q_f32(p); }
+	inline void storeFloat(float *p, Float a) { vst1q_f32(p, a); }
+	inline Float setFloat(float a) { return vdupq_n_f32(a); }
+	inline Int setInt(int a) { return vdupq_n_s32(a); }
+	inline Float add(Float a, Float b) { return vaddq_f32(a, b); }
+	inline Float sub(Float a, Float b) { return vsubq_f32(a, b); }
+	inline Float mul(Float a, Float b) { return vmulq_f32(a, b); }
+	inline Int add(Int a, Int b) { return vaddq_s32(a, b); }
+	inline Int bitAnd(Int a, Int b) { return vandq_s32(a, b); }
+	inline Int bitAndNot(Int a, Int b) { return vbicq_s32(b, a); } // ~a & b
+	inline Int bitOr(Int a, Int b) { return vorrq_s32(a, b); }
+	inline Int bitXor(Int a, Int b) { return veorq_s32(a, b); }
+	inline Int equal(Int a, Int b) { return vreinterpretq_s32_u32(vceqq_s32(a, b)); }
+	inline Int asInt(Float a) { return vreinterpretq_s32_f32(a); }
+	inline Float asFloat(Int a) { return vreinterpretq_f32_s32(a); }
+	inline Int roundToInt(Float a) { return vcvtq_s32_f32(a); }
+	inline Float floor(Float a) { return vrndmq_f32(a); }
+	inline Int shiftRight(Int a, int count) { return vreinterpretq_s32_u32(vshlq_u32(vreinterpretq_u32_s32(a), vdupq_n_s32(-count))); }
+	inline Int mulLow(Int a, Int b) { return vmulq_s32(a, b); }
+
+	// NEON has no gather instruction so looks each lane up separately
+	inline Int gather(const int32_t *table, Int index)
+	{
+		int lanes[4];
+		vst1q_s32(lanes, index);
+		int values[4] = { table[lanes[0]], table[lanes[1]], table[lanes[2]], table[lanes[3]] };
+		return vld1q_s32(values);
+	}
+
+	inline Int gatherBytes(const uint8_t *table, Int index)
+	{
+		int lanes[4];
+		vst1q_s32(lanes, index);
+		int values[4] = { table[lanes[0]], table[lanes[1]], table[lanes[2]], table[lanes[3]] };
+		return vld1q_s32(values);
+	}
+
+#include "noise_kernel.inl"
+}
+#endif
+
+// Checks whether the processor and operating system support AVX2
+inline bool cpuSupportsAvx2()
+{
+#if NOISE_X86 && defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+	__cpuidex(info, 7, 0);
+	return osSavesYmm && (info[1] & (1 << 5));
+#elif NOISE_X86
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+/*
+Frame time and generation profiler.
+CPU stages are timed with ScopedTimer, which may be used from any thread (worker time is summed over every worker),
+and the GPU time of drawing the terrain is measured with GL_TIME_ELAPSED queries that are only read back once their
+result is available so timing never stalls the pipeline. Every profileReportInterval seconds the collected frames
+are summarised (frame time percentiles, mean time of each stage per frame, noise samples per second) into a one
+line summary and, if a path was given, a row of a CSV file.
+*/
+
+enum ProfileTimer
+{
+	profileNoise, // Noise evaluation on the worker threads
+	profileUpload, // Copying finished and cached chunks into the vertex buffer
+	profileDraw, // Selecting, culling and submitting the terrain on the render thread
+	profileTimerCount
+};
+
+const char *const profileTimerNames[profileTimerCount] = { "noise", "upload", "draw" };
+
+// Seconds between reports
+const double profileReportInterval = 1.0;
+
+// GPU timer queries in flight, results arrive a few frames late
+const int profileQueryCount = 4;
+
+// Value below which fraction of the values lie, values is reordered
+inline double percentile(std::vector<double> &values, double fraction)
+{
+	if (values.empty()) return 0.0;
+	size_t index = std::min((size_t)(fraction * values.size()), values.size() - 1);
+	std::nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
+
+class Profiler
+{
+public:
+	~Profiler()
+	{
+		if (queries[0]) glDeleteQueries(profileQueryCount, queries);
+		if (csv) std::fclose(csv);
+	}
+
+	// Creates the timer queries and, if csvPath isn't NULL, the CSV file reports are written to
+	bool initialise(const char *csvPath)
+	{
+		glGenQueries(profileQueryCount, queries);
+		if (!csvPath) return true;
+
+		csv = std::fopen(csvPath, "w");
+		if (!csv) return false;
+		std::fprintf(csv, "time,frames,frame_p50_ms,frame_p95_ms,frame_p99_ms");
+		for (const char *name : profileTimerNames) std::fprintf(csv, ",%s_ms", name);
+		std::fprintf(csv, ",gpu_draw_p50_ms,gpu_draw_p95_ms,samples_per_second\n");
+		return true;
+	}
+
+	// Adds seconds of time spent in timer, can be called from any thread
+	void add(ProfileTimer timer, double seconds)
+	{
+		nanoseconds[timer].fetch_add((uint64_t)(seconds * 1e9), std::memory_order_relaxed);
+	}
+
+	// Adds to the number of noise samples evaluated, can be called from any thread
+	void addSamples(uint64_t count)
+	{
+		samples.fetch_add(count, std::memory_order_relaxed);
+	}
+
+	// Starts timing GPU work, skipped if every query is still waiting for its result
+	void beginGpu()
+	{
+		activeQuery = -1;
+		if (queryPending[nextQuery]) return;
+		activeQuery = nextQuery;
+		glBeginQuery(GL_TIME_ELAPSED, queries[activeQuery]);
+	}
+
+	void endGpu()
+	{
+		if (activeQuery < 0) return;
+		glEndQuery(GL_TIME_ELAPSED);
+		queryPending[activeQuery] = true;
+		nextQuery = (nextQuery + 1) % profileQueryCount;
+		activeQuery = -1;
+	}
+
+	// Records a frame that took frameSeconds, returns true when a new report has been made
+	bool endFrame(double frameSeconds)
+	{
+		frameTimes.push_back(frameSeconds * 1000.0);
+		elapsed += frameSeconds;
+
+		// Reads back every query whose result has arrived
+		for (int i = 0; i < profileQueryCount; i++)
+		{
+			if (!queryPending[i]) continue;
+			int available = 0;
+			glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) continue;
+			GLuint64 time = 0;
+			glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &time);
+			gpuTimes.push_back(time / 1e6);
+			queryPending[i] = false;
+		}
+
+		if (elapsed < profileReportInterval) return false;
+		report();
+		return true;
+	}
+
+	// One line description of the last report
+	const std::string &summary() const
+	{
+		return summaryText;
+	}
+
+private:
+	void report()
+	{
+		double frames = (double)frameTimes.size();
+		double frame50 = percentile(frameTimes, 0.5);
+		double frame95 = percentile(frameTimes, 0.95);
+		double frame99 = percentile(frameTimes, 0.99);
+		double gpu50 = percentile(gpuTimes, 0.5);
+		double gpu95 = percentile(gpuTimes, 0.95);
+		double stageTimes[profileTimerCount];
+		for (int i = 0; i < profileTimerCount; i++) stageTimes[i] = nanoseconds[i].exchange(0, std::memory_order_relaxed) / 1e6 / frames;
+		double samplesPerSecond = samples.exchange(0, std::memory_order_relaxed) / elapsed;
+
+		char text[256];
+		std::snprintf(text, sizeof(text), "frame %.2f / %.2f / %.2f ms (p50 / p95 / p99) | gpu %.2f ms | upload %.2f ms | %.1f M samples/s",
+			frame50, frame95, frame99, gpu50, stageTimes[profileUpload], samplesPerSecond / 1e6);
+		summaryText = text;
+
+		if (csv)
+		{
+			reportTime += elapsed;
+			std::fprintf(csv, "%.3f,%d,%.3f,%.3f,%.3f", reportTime, (int)frames, frame50, frame95, frame99);
+			for (double time : stageTimes) std::fprintf(csv, ",%.3f", time);
+			std::fprintf(csv, ",%.3f,%.3f,%.0f\n", gpu50, gpu95, samplesPerSecond);
+			std::fflush(csv);
+		}
+
+		frameTimes.clear();
+		gpuTimes.clear();
+		elapsed = 0.0;
+	}
+
+	// Totals since the last report
+	std::atomic<uint64_t> nanoseconds[profileTimerCount] = {};
+	std::atomic<uint64_t> samples{ 0 };
+	std::vector<double> frameTimes;
+	std::vector<double> gpuTimes;
+	double elapsed = 0.0;
+
+	unsigned int queries[profileQueryCount] = {};
+	bool queryPending[profileQueryCount] = {};
+	int nextQuery = 0;
+	int activeQuery = -1;
+
+	FILE *csv = NULL;
+	double reportTime = 0.0;
+	std::string summaryText;
+};
+
+// Adds the time between its construction and destruction to a timer of profiler, which may be NULL
+class ScopedTimer
+{
+public:
+	ScopedTimer(Profiler *profiler, ProfileTimer timer)
+		: profiler(profiler), timer(timer), start(std::chrono::steady_clock::now())
+	{
+	}
+
+	~ScopedTimer()
+	{
+		if (profiler) profiler->add(timer, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+
+private:
+	Profiler *profiler;
+	ProfileTimer timer;
+	std::chrono::steady_clock::time_point start;
+};
@@ -0,0 +1,339 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <glad/glad.h>
+
+/*
+Builds the shader programs from the files in the shaders directory next to the executable, falling back to one in
+the working directory so running from the source tree still works. Compile and link logs are printed with the
+file they came from, and a program that fails to build is never handed out half made.
+Linked programs are saved with glGetProgramBinary (OpenGL 4.1 or ARB_get_program_binary) and loaded straight back
+on the next launch, skipping compilation. Each binary is stored under a hash of its sources and the driver's vendor,
+renderer and version, so editing a shader or updating the driver builds it again, as does the driver rejecting it.
+Optionally the files are watched, and programs whose sources change are rebuilt, replacing the old program only if
+the new one builds.
+*/
+
+const char shaderCacheMagic[4] = { 'P', 'T', 'S', 'C' };
+const uint32_t shaderCacheVersion = 1;
+
+// Seconds between checks for changed shader files when hot reloading
+const double shaderPollInterval = 0.5;
+
+// Shader of a program, name is relative to the shaders directory
+struct ShaderSource
+{
+	GLenum type;
+	const char *name;
+};
+
+class ShaderManager
+{
+public:
+	~ShaderManager()
+	{
+		for (ManagedProgram &managed : programs)
+		{
+			if (managed.program) glDeleteProgram(managed.program);
+		}
+	}
+
+	/*
+	Finds the shaders directory from executablePath (argv[0], used if the platform can't say where the executable
+	is) and caches program binaries in cacheDirectory, or nowhere if it is NULL. Needs a current context.
+	*/
+	void initialise(const char *executablePath, const char *cacheDirectory)
+	{
+		std::error_code error;
+		std::filesystem::path nextToExecutable = executableDirectory(executablePath) / "shaders";
+		shaderDirectory = std::filesystem::is_directory(nextToExecutable, error) ? nextToExecutable : std::filesystem::path("shaders");
+
+		int formats = 0;
+		if (GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		if (!cacheDirectory || formats == 0) return;
+		std::filesystem::create_directories(cacheDirectory, error);
+		if (error) return;
+		this->cacheDirectory = cacheDirectory;
+
+		// Binaries are only valid for the driver that made them
+		for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+		{
+			const char *text = (const char *)glGetString(name);
+			if (text) driverHash = hashBytes(driverHash, text, std::strlen(text));
+		}
+	}
+
+	// Builds a program from sources, returns its index or -1 if it couldn't be loaded or built
+	int add(std::initializer_list<ShaderSource> sources)
+	{
+		ManagedProgram managed;
+		for (const ShaderSource &source : sources) managed.sources.push_back({ source.type, source.name, {} });
+		managed.program = build(managed);
+		if (!managed.program) return -1;
+		programs.push_back(managed);
+		return (int)programs.size() - 1;
+	}
+
+	// Current program of index, which changes when it is reloaded
+	unsigned int program(int index) const
+	{
+		return index < 0 ? 0 : programs[index].program;
+	}
+
+	/*
+	Rebuilds programs whose files have changed since they were built, checking at most every shaderPollInterval
+	seconds, seconds being the time since the last call. Returns true if any program was replaced: the old one is
+	deleted, so anything set on it, like uniform values and block bindings, has to be set again on the new one.
+	*/
+	bool reload(double seconds)
+	{
+		sincePoll += seconds;
+		if (sincePoll < shaderPollInterval) return false;
+		sincePoll = 0.0;
+
+		bool replaced = false;
+		for (ManagedProgram &managed : programs)
+		{
+			bool changed = false;
+			for (ManagedSource &source : managed.sources)
+			{
+				std::error_code error;
+				std::filesystem::file_time_type modified = std::filesystem::last_write_time(shaderDirectory / source.name, error);
+				if (!error && modified != source.modified) changed = true;
+			}
+			if (!changed) continue;
+
+			unsigned int rebuilt = build(managed);
+			if (!rebuilt) continue;
+			glDeleteProgram(managed.program);
+			managed.program = rebuilt;
+			replaced = true;
+			std::cout << "Reloaded " << managed.sources[0].name << '\n';
+		}
+		return replaced;
+	}
+
+	// Directory the running executable is in, from executablePath (argv[0]) if the platform can't say
+	static std::filesystem::path executableDirectory(const char *executablePath)
+	{
+#if defined(_WIN32)
+		char buffer[MAX_PATH];
+		DWORD length = GetModuleFileNameA(NULL, buffer, MAX_PATH);
+		if (length > 0 && length < MAX_PATH) return std::filesystem::path(std::string(buffer, length)).parent_path();
+#else
+		char buffer[4096];
+		ssize_t length = readlink("/proc/self/exe", buffer, sizeof(buffer));
+		if (length > 0 && length < (ssize_t)sizeof(buffer)) return std::filesystem::path(std::string(buffer, length)).parent_path();
+#endif
+		return executablePath ? std::filesystem::path(executablePath).parent_path() : std::filesystem::path();
+	}
+
+	// Number of programs built by compiling and by loading a cached binary
+	int compiledCount() const
+	{
+		return compiled;
+	}
+
+	int cachedCount() const
+	{
+		return cached;
+	}
+
+private:
+	struct ManagedSource
+	{
+		GLenum type;
+		std::string name;
+		std::filesystem::file_time_type modified;
+	};
+
+	struct ManagedProgram
+	{
+		std::vector<ManagedSource> sources;
+		unsigned int program = 0;
+	};
+
+	// File header of a cached program binary, followed by the binary itself
+	struct CacheHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint32_t format;
+		uint32_t length;
+	};
+
+	// FNV-1a, stable between runs and platforms as the key is saved to disk
+	static uint64_t hashBytes(uint64_t hash, const void *data, size_t bytes)
+	{
+		const uint8_t *bytesIn = (const uint8_t *)data;
+		for (size_t i = 0; i < bytes; i++)
+		{
+			hash ^= bytesIn[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// Loads the sources of managed and makes a program from them, from the cache if it can, 0 on failure
+	unsigned int build(ManagedProgram &managed)
+	{
+		std::vector<std::string> texts;
+		uint64_t key = driverHash;
+		for (ManagedSource &source : managed.sources)
+		{
+			std::filesystem::path path = shaderDirectory / source.name;
+			std::ifstream file(path, std::ios::binary);
+			if (!file)
+			{
+				std::cout << "Couldn't open shader " << path.string() << '\n';
+				return 0;
+			}
+			texts.emplace_back((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			std::error_code error;
+			source.modified = std::filesystem::last_write_time(path, error);
+			key = hashBytes(key, &source.type, sizeof(source.type));
+			key = hashBytes(key, texts.back().data(), texts.back().size());
+		}
+
+		unsigned int program = loadCached(key);
+		if (program)
+		{
+			cached++;
+			return program;
+		}
+
+		program = glCreateProgram();
+		std::vector<unsigned int> shaders;
+		bool built = true;
+		for (size_t i = 0; i < managed.sources.size() && built; i++)
+		{
+			const char *text = texts[i].c_str();
+			unsigned int shader = glCreateShader(managed.sources[i].type);
+			glShaderSource(shader, 1, &text, NULL);
+			glCompileShader(shader);
+			int status;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+			if (!status) built = false;
+			printLog(managed.sources[i].name, shader, false, !status);
+			glAttachShader(program, shader);
+			shaders.push_back(shader);
+		}
+
+		if (built)
+		{
+			if (!cacheDirectory.empty()) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			glLinkProgram(program);
+			int status;
+			glGetProgramiv(program, GL_LINK_STATUS, &status);
+			if (!status) built = false;
+			printLog(managed.sources[0].name, program, true, !status);
+		}
+
+		for (unsigned int shader : shaders)
+		{
+			glDetachShader(program, shader);
+			glDeleteShader(shader);
+		}
+		if (!built)
+		{
+			glDeleteProgram(program);
+			return 0;
+		}
+
+		saveCached(key, program);
+		compiled++;
+		return program;
+	}
+
+	// Prints a shader's or program's info log, which drivers also fill with warnings, always printed if failed
+	static void printLog(const std::string &name, unsigned int object, bool isProgram, bool failed)
+	{
+		int length = 0;
+		if (isProgram) glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+		else glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+		if (length <= 1 && !failed) return;
+
+		std::string log(std::max(length, 1), '\0');
+		if (isProgram) glGetProgramInfoLog(object, length, NULL, &log[0]);
+		else glGetShaderInfoLog(object, length, NULL, &log[0]);
+		std::cout << (failed ? "Couldn't " : "Warnings from ") << (isProgram ? "link " : "compile ") << name << ":\n" << log.c_str() << '\n';
+	}
+
+	std::filesystem::path cachePath(uint64_t key) const
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+		return cacheDirectory / name;
+	}
+
+	// Program linked from the binary cached under key, or 0 if there isn't one or the driver rejects it
+	unsigned int loadCached(uint64_t key)
+	{
+		if (cacheDirectory.empty()) return 0;
+		std::ifstream file(cachePath(key), std::ios::binary);
+		CacheHeader header;
+		if (!file.read((char *)&header, sizeof(header))) return 0;
+		if (std::memcmp(header.magic, shaderCacheMagic, sizeof(shaderCacheMagic)) != 0 || header.version != shaderCacheVersion || header.key != key) return 0;
+		std::vector<char> binary(header.length);
+		if (!file.read(binary.data(), header.length)) return 0;
+
+		unsigned int program = glCreateProgram();
+		glProgramBinary(program, header.format, binary.data(), header.length);
+		int status;
+		glGetProgramiv(program, GL_LINK_STATUS, &status);
+		if (status) return program;
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	void saveCached(uint64_t key, unsigned int program) const
+	{
+		if (cacheDirectory.empty()) return;
+		int length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) return;
+
+		std::vector<char> binary(length);
+		CacheHeader header;
+		std::memcpy(header.magic, shaderCacheMagic, sizeof(shaderCacheMagic));
+		header.version = shaderCacheVersion;
+		header.key = key;
+		GLenum format = 0;
+		glGetProgramBinary(program, length, NULL, &format, binary.data());
+		header.format = format;
+		header.length = (uint32_t)length;
+
+		std::ofstream file(cachePath(key), std::ios::binary | std::ios::trunc);
+		file.write((const char *)&header, sizeof(header));
+		file.write(binary.data(), length);
+	}
+
+	std::filesystem::path shaderDirectory;
+	std::filesystem::path cacheDirectory;
+	uint64_t driverHash = 14695981039346656037ull;
+	std::vector<ManagedProgram> programs;
+	double sincePoll = 0.0;
+	int compiled = 0;
+	int cached = 0;
+};
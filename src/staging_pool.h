@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+
+/*
+Pool of equally sized staging buffers that chunks are generated straight into and then copied to the vertex buffer
+on the GPU with glCopyBufferSubData, so no vertex data is copied on the CPU and writing never waits on the GPU.
+Blocks are handed out and given back in any order as chunks finish at different times. With OpenGL 4.4 or
+ARB_buffer_storage each block is allocated once with glBufferStorage and stays persistently mapped, a fence after
+the copy out of a block tells when it can be written again. Other contexts orphan the block's storage and map it
+with GL_MAP_UNSYNCHRONIZED_BIT each time it is acquired, which the driver can do without waiting as the old storage
+is still owned by the copy in flight.
+*/
+class StagingPool
+{
+public:
+	~StagingPool()
+	{
+		for (Block &block : blocks)
+		{
+			if (block.fence) glDeleteSync(block.fence);
+			if (block.buffer) glDeleteBuffers(1, &block.buffer);
+		}
+	}
+
+	void initialise(size_t blockBytes, int blockCount)
+	{
+		this->blockBytes = blockBytes;
+		persistent = GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage;
+		blocks.resize(blockCount);
+
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		for (Block &block : blocks)
+		{
+			glGenBuffers(1, &block.buffer);
+			glBindBuffer(GL_COPY_READ_BUFFER, block.buffer);
+			if (persistent)
+			{
+				glBufferStorage(GL_COPY_READ_BUFFER, blockBytes, NULL, flags);
+				block.mapping = glMapBufferRange(GL_COPY_READ_BUFFER, 0, blockBytes, flags);
+			}
+			else
+			{
+				glBufferData(GL_COPY_READ_BUFFER, blockBytes, NULL, GL_STREAM_COPY);
+			}
+		}
+	}
+
+	// Whether blocks are persistently mapped rather than mapped each time they are acquired
+	bool isPersistent() const
+	{
+		return persistent;
+	}
+
+	int size() const
+	{
+		return (int)blocks.size();
+	}
+
+	// Returns a block to write into, or -1 without waiting if every block is in use or still being copied from
+	int acquire()
+	{
+		for (int index = 0; index < (int)blocks.size(); index++)
+		{
+			Block &block = blocks[index];
+			if (block.acquired) continue;
+			if (block.fence)
+			{
+				if (glClientWaitSync(block.fence, 0, 0) == GL_TIMEOUT_EXPIRED) continue;
+				glDeleteSync(block.fence);
+				block.fence = 0;
+			}
+
+			if (!persistent)
+			{
+				glBindBuffer(GL_COPY_READ_BUFFER, block.buffer);
+				glBufferData(GL_COPY_READ_BUFFER, blockBytes, NULL, GL_STREAM_COPY);
+				block.mapping = glMapBufferRange(GL_COPY_READ_BUFFER, 0, blockBytes, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			}
+			block.acquired = true;
+			return index;
+		}
+		return -1;
+	}
+
+	// Memory of an acquired block, valid until it is copied or released
+	void *data(int index) const
+	{
+		return blocks[index].mapping;
+	}
+
+	// Copies the whole of an acquired block to destinationOffset of destination
+	void copy(int index, unsigned int destination, size_t destinationOffset)
+	{
+		Block &block = blocks[index];
+		unmap(block);
+		glBindBuffer(GL_COPY_READ_BUFFER, block.buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, destination);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, destinationOffset, blockBytes);
+		block.copied = true;
+	}
+
+	// Gives a block back, it is handed out again once any copy out of it has finished
+	void release(int index)
+	{
+		Block &block = blocks[index];
+		unmap(block);
+		if (persistent && block.copied) block.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		block.acquired = false;
+		block.copied = false;
+	}
+
+private:
+	struct Block
+	{
+		unsigned int buffer = 0;
+		void *mapping = NULL;
+		GLsync fence = 0;
+		bool acquired = false;
+		bool copied = false;
+	};
+
+	void unmap(Block &block)
+	{
+		if (persistent || !block.mapping) return;
+		glBindBuffer(GL_COPY_READ_BUFFER, block.buffer);
+		glUnmapBuffer(GL_COPY_READ_BUFFER);
+		block.mapping = NULL;
+	}
+
+	std::vector<Block> blocks;
+	size_t blockBytes = 0;
+	bool persistent = false;
+};
@@ -0,0 +1,533 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "fractal_noise.h"
+
+/*
+Height queries for gameplay and physics, answered from tiles of heights kept on the CPU rather than by evaluating
+the noise for every query. Tiles line up with the chunks of the finest level of detail and hold the same noise
+(the terrain's octaves down to the finest level's detail) at every lattice point, between which the surface is
+bilinear. Each tile also keeps a min/max pyramid: level 0 bounds each square between four lattice points, and each
+level above bounds four nodes of the level below, up to one node bounding the whole tile. Raycasts walk the tiles
+along the ray and descend each tile's pyramid front to back, skipping any node the ray passes over, so they touch
+O(log n) nodes over open ground instead of marching sample by sample, and only solve the exact intersection with
+the squares they reach.
+Every query may be made from any thread. Tiles are generated the first time they are needed, by the thread that
+needs them, and are never changed once made. The cache holds a fixed number of tiles and replaces the oldest when
+full; queries keep the tiles they are reading alive until they are done with them. Erosion isn't applied, so the
+heights are those of the uneroded terrain.
+*/
+
+// Number of squares along each side of a tile, the same as a chunk
+const int queryTileSize = 64;
+const int queryTileVertexSize = queryTileSize + 1;
+
+// Levels of each tile's pyramid, from single squares up to the whole tile
+const int queryPyramidLevels = 7;
+static_assert((1 << (queryPyramidLevels - 1)) == queryTileSize, "The top of the pyramid must cover the whole tile");
+
+// Number of nodes in every level of a tile's pyramid together
+const int queryPyramidNodes = (4 * queryTileSize * queryTileSize - 1) / 3;
+
+// Tiles kept at once by default, around 60 KB each
+const size_t queryTileCapacity = 256;
+
+// direction must be normalised, the distance of a hit is along it from origin
+struct TerrainRay
+{
+	glm::dvec3 origin;
+	glm::vec3 direction;
+	float maxDistance;
+};
+
+struct TerrainHit
+{
+	bool hit; // Whether the ray reaches the surface within its maxDistance, nothing else is set if it doesn't
+	float distance; // Distance to the first point on or below the surface, 0 if the ray starts below it
+	glm::dvec3 position;
+	glm::vec3 normal;
+};
+
+struct QueryTile
+{
+	int64_t x, z; // Tile coordinates, the world position of the first lattice point divided by queryTileSize
+	float heights[queryTileVertexSize * queryTileVertexSize]; // Ordered by x then z like chunk vertices
+	float minimum[queryPyramidNodes];
+	float maximum[queryPyramidNodes];
+
+	// First node of a level of the pyramid, whose nodes are ordered by x then z
+	static int levelOffset(int level)
+	{
+		int offset = 0;
+		for (int l = 0; l < level; l++) offset += (queryTileSize >> l) * (queryTileSize >> l);
+		return offset;
+	}
+
+	float height(int i, int j) const
+	{
+		return heights[i * queryTileVertexSize + j];
+	}
+};
+
+class TerrainQuery
+{
+public:
+	explicit TerrainQuery(const FractalNoise &noise, size_t capacity = queryTileCapacity)
+		: noise(noise.withoutOctavesFinerThan(2.0f)), capacity(std::max<size_t>(capacity, 1)), lowest(this->noise.minimumHeight()), highest(this->noise.maximumHeight())
+	{
+		order.reserve(this->capacity);
+	}
+
+	// Height of the surface at world position (x, z)
+	float height(double x, double z)
+	{
+		int64_t tileX, tileZ;
+		float u, v;
+		locate(x, z, tileX, tileZ, u, v);
+		std::shared_ptr<const QueryTile> tile = find(tileX, tileZ);
+		return bilinear(*tile, u, v);
+	}
+
+	// Unit normal of the surface at world position (x, z)
+	glm::vec3 normal(double x, double z)
+	{
+		int64_t tileX, tileZ;
+		float u, v;
+		locate(x, z, tileX, tileZ, u, v);
+		std::shared_ptr<const QueryTile> tile = find(tileX, tileZ);
+		return surfaceNormal(*tile, u, v);
+	}
+
+	/*
+	Lowest and highest height of the surface over the rectangle from (minimumX, minimumZ) to (maximumX, maximumZ).
+	Whole nodes of the pyramid inside the rectangle are bounded by their stored range, the surface being bilinear
+	means squares cut by its edges are bounded by the heights at the corners of the part inside.
+	*/
+	void bounds(double minimumX, double minimumZ, double maximumX, double maximumZ, float &minimum, float &maximum)
+	{
+		minimum = INFINITY;
+		maximum = -INFINITY;
+		int64_t tileXStart = (int64_t)std::floor(minimumX / queryTileSize);
+		int64_t tileXEnd = (int64_t)std::floor(maximumX / queryTileSize);
+		int64_t tileZStart = (int64_t)std::floor(minimumZ / queryTileSize);
+		int64_t tileZEnd = (int64_t)std::floor(maximumZ / queryTileSize);
+		for (int64_t tileX = tileXStart; tileX <= tileXEnd; tileX++)
+		{
+			for (int64_t tileZ = tileZStart; tileZ <= tileZEnd; tileZ++)
+			{
+				std::shared_ptr<const QueryTile> tile = find(tileX, tileZ);
+				double originX = (double)(tileX * queryTileSize);
+				double originZ = (double)(tileZ * queryTileSize);
+				float x0 = (float)std::max(minimumX - originX, 0.0);
+				float x1 = (float)std::min(maximumX - originX, (double)queryTileSize);
+				float z0 = (float)std::max(minimumZ - originZ, 0.0);
+				float z1 = (float)std::min(maximumZ - originZ, (double)queryTileSize);
+				tileBounds(*tile, x0, x1, z0, z1, minimum, maximum);
+			}
+		}
+	}
+
+	// Casts count rays, writing where each first reaches the surface to hits
+	void raycast(const TerrainRay *rays, TerrainHit *hits, size_t count)
+	{
+		std::shared_ptr<const QueryTile> tile;
+		for (size_t i = 0; i < count; i++) hits[i] = cast(rays[i], tile);
+	}
+
+	// Number of tiles generated so far, including ones generated again after being replaced
+	uint64_t tilesGenerated() const
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		return generated;
+	}
+
+private:
+	struct TileKey
+	{
+		int64_t x, z;
+
+		bool operator==(const TileKey &other) const
+		{
+			return x == other.x && z == other.z;
+		}
+	};
+
+	struct TileKeyHash
+	{
+		size_t operator()(const TileKey &key) const
+		{
+			uint64_t hash = (uint64_t)key.x * 0x9E3779B97F4A7C15ull ^ (uint64_t)key.z * 0xC2B2AE3D27D4EB4Full;
+			return (size_t)(hash ^ (hash >> 32));
+		}
+	};
+
+	// Tile a world position lies in and the position within it
+	static void locate(double x, double z, int64_t &tileX, int64_t &tileZ, float &u, float &v)
+	{
+		tileX = (int64_t)std::floor(x / queryTileSize);
+		tileZ = (int64_t)std::floor(z / queryTileSize);
+		u = (float)(x - (double)(tileX * queryTileSize));
+		v = (float)(z - (double)(tileZ * queryTileSize));
+	}
+
+	// Square containing tile position (u, v) and the position within it
+	static void square(float u, float v, int &i, int &j, float &s, float &t)
+	{
+		i = std::min(std::max((int)std::floor(u), 0), queryTileSize - 1);
+		j = std::min(std::max((int)std::floor(v), 0), queryTileSize - 1);
+		s = u - i;
+		t = v - j;
+	}
+
+	static float bilinear(const QueryTile &tile, float u, float v)
+	{
+		int i, j;
+		float s, t;
+		square(u, v, i, j, s, t);
+		return squareHeight(tile, i, j, s, t);
+	}
+
+	// Height at (s, t) between 0 and 1 across square (i, j)
+	static float squareHeight(const QueryTile &tile, int i, int j, float s, float t)
+	{
+		float h00 = tile.height(i, j), h10 = tile.height(i + 1, j), h01 = tile.height(i, j + 1), h11 = tile.height(i + 1, j + 1);
+		return h00 + (h10 - h00) * s + (h01 - h00) * t + (h00 - h10 - h01 + h11) * s * t;
+	}
+
+	static glm::vec3 surfaceNormal(const QueryTile &tile, float u, float v)
+	{
+		int i, j;
+		float s, t;
+		square(u, v, i, j, s, t);
+		float h00 = tile.height(i, j), h10 = tile.height(i + 1, j), h01 = tile.height(i, j + 1), h11 = tile.height(i + 1, j + 1);
+		float slopeX = (1.0f - t) * (h10 - h00) + t * (h11 - h01);
+		float slopeZ = (1.0f - s) * (h01 - h00) + s * (h11 - h10);
+		return glm::normalize(glm::vec3(-slopeX, 1.0f, -slopeZ));
+	}
+
+	// Tile (x, z), generating it if it isn't cached
+	std::shared_ptr<const QueryTile> find(int64_t x, int64_t z)
+	{
+		TileKey key = { x, z };
+		{
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			auto found = tiles.find(key);
+			if (found != tiles.end()) return found->second;
+		}
+
+		// Generated without holding the lock, if another thread got there first its tile is used instead
+		std::shared_ptr<QueryTile> tile = std::make_shared<QueryTile>();
+		generate(*tile, x, z);
+
+		std::unique_lock<std::shared_mutex> lock(mutex);
+		auto found = tiles.find(key);
+		if (found != tiles.end()) return found->second;
+		if (order.size() < capacity)
+		{
+			order.push_back(key);
+		}
+		else
+		{
+			tiles.erase(order[nextReplaced]);
+			order[nextReplaced] = key;
+			nextReplaced = (nextReplaced + 1) % capacity;
+		}
+		tiles.emplace(key, tile);
+		generated++;
+		return tile;
+	}
+
+	// Evaluates the heights of tile (x, z) relative to its first lattice point, as chunks are, and builds its pyramid
+	void generate(QueryTile &tile, int64_t x, int64_t z) const
+	{
+		tile.x = x;
+		tile.z = z;
+		const NoiseOrigin origin = { x * queryTileSize, z * queryTileSize };
+		float zPositions[queryTileVertexSize];
+		for (int j = 0; j < queryTileVertexSize; j++) zPositions[j] = (float)j;
+		for (int i = 0; i < queryTileVertexSize; i++) noise.heightRow(origin, (float)i, zPositions, &tile.heights[i * queryTileVertexSize], queryTileVertexSize);
+
+		for (int i = 0; i < queryTileSize; i++)
+		{
+			for (int j = 0; j < queryTileSize; j++)
+			{
+				float h00 = tile.height(i, j), h10 = tile.height(i + 1, j), h01 = tile.height(i, j + 1), h11 = tile.height(i + 1, j + 1);
+				tile.minimum[i * queryTileSize + j] = std::min(std::min(h00, h10), std::min(h01, h11));
+				tile.maximum[i * queryTileSize + j] = std::max(std::max(h00, h10), std::max(h01, h11));
+			}
+		}
+		for (int level = 1; level < queryPyramidLevels; level++)
+		{
+			int size = queryTileSize >> level;
+			const float *childMinimum = tile.minimum + QueryTile::levelOffset(level - 1);
+			const float *childMaximum = tile.maximum + QueryTile::levelOffset(level - 1);
+			float *nodeMinimum = tile.minimum + QueryTile::levelOffset(level);
+			float *nodeMaximum = tile.maximum + QueryTile::levelOffset(level);
+			for (int i = 0; i < size; i++)
+			{
+				for (int j = 0; j < size; j++)
+				{
+					int child = 2 * i * 2 * size + 2 * j;
+					nodeMinimum[i * size + j] = std::min(std::min(childMinimum[child], childMinimum[child + 1]), std::min(childMinimum[child + 2 * size], childMinimum[child + 2 * size + 1]));
+					nodeMaximum[i * size + j] = std::max(std::max(childMaximum[child], childMaximum[child + 1]), std::max(childMaximum[child + 2 * size], childMaximum[child + 2 * size + 1]));
+				}
+			}
+		}
+	}
+
+	// Widens minimum and maximum by the surface of tile over tile positions [x0, x1] by [z0, z1]
+	static void tileBounds(const QueryTile &tile, float x0, float x1, float z0, float z1, float &minimum, float &maximum)
+	{
+		struct Node
+		{
+			int level, i, j;
+		};
+		Node stack[4 * queryPyramidLevels];
+		int stackSize = 0;
+		stack[stackSize++] = { queryPyramidLevels - 1, 0, 0 };
+		while (stackSize > 0)
+		{
+			Node node = stack[--stackSize];
+			float size = (float)(1 << node.level);
+			float nodeX0 = node.i * size, nodeX1 = nodeX0 + size;
+			float nodeZ0 = node.j * size, nodeZ1 = nodeZ0 + size;
+			if (nodeX0 > x1 || nodeX1 < x0 || nodeZ0 > z1 || nodeZ1 < z0) continue;
+
+			int index = QueryTile::levelOffset(node.level) + node.i * (queryTileSize >> node.level) + node.j;
+			if (nodeX0 >= x0 && nodeX1 <= x1 && nodeZ0 >= z0 && nodeZ1 <= z1)
+			{
+				minimum = std::min(minimum, tile.minimum[index]);
+				maximum = std::max(maximum, tile.maximum[index]);
+			}
+			else if (node.level == 0)
+			{
+				// A bilinear surface has its extremes over a rectangle at the rectangle's corners
+				float cornerX[2] = { std::max(x0, nodeX0) - nodeX0, std::min(x1, nodeX1) - nodeX0 };
+				float cornerZ[2] = { std::max(z0, nodeZ0) - nodeZ0, std::min(z1, nodeZ1) - nodeZ0 };
+				for (float s : cornerX)
+				{
+					for (float t : cornerZ)
+					{
+						float height = squareHeight(tile, node.i, node.j, s, t);
+						minimum = std::min(minimum, height);
+						maximum = std::max(maximum, height);
+					}
+				}
+			}
+			else
+			{
+				for (int child = 0; child < 4; child++) stack[stackSize++] = { node.level - 1, 2 * node.i + (child >> 1), 2 * node.j + (child & 1) };
+			}
+		}
+	}
+
+	/*
+	Casts ray over the tiles it crosses between entering and leaving the band of heights the noise can produce,
+	nearest first. tile is the last tile used, kept between the rays of a batch as consecutive rays often start in
+	the same tile.
+	*/
+	TerrainHit cast(const TerrainRay &ray, std::shared_ptr<const QueryTile> &tile)
+	{
+		TerrainHit hit = {};
+		double tStart = 0.0;
+		double tEnd = ray.maxDistance;
+		if (ray.direction.y != 0.0f)
+		{
+			double tLowest = (lowest - ray.origin.y) / ray.direction.y;
+			double tHighest = (highest - ray.origin.y) / ray.direction.y;
+			tStart = std::max(tStart, std::min(tLowest, tHighest));
+			tEnd = std::min(tEnd, std::max(tLowest, tHighest));
+		}
+		else if (ray.origin.y > highest)
+		{
+			return hit;
+		}
+		if (ray.origin.y <= lowest)
+		{
+			// Below every height the noise can produce, so already below the surface
+			tStart = 0.0;
+			tEnd = 0.0;
+		}
+		if (tStart > tEnd) return hit;
+
+		// Steps through the tiles along the ray in the order it crosses them
+		double x = ray.origin.x + ray.direction.x * tStart;
+		double z = ray.origin.z + ray.direction.z * tStart;
+		int64_t tileX = (int64_t)std::floor(x / queryTileSize);
+		int64_t tileZ = (int64_t)std::floor(z / queryTileSize);
+		int stepX = ray.direction.x > 0.0f ? 1 : -1;
+		int stepZ = ray.direction.z > 0.0f ? 1 : -1;
+		double tDeltaX = ray.direction.x != 0.0f ? queryTileSize / std::fabs((double)ray.direction.x) : INFINITY;
+		double tDeltaZ = ray.direction.z != 0.0f ? queryTileSize / std::fabs((double)ray.direction.z) : INFINITY;
+		double tNextX = ray.direction.x != 0.0f ? ((double)((tileX + (stepX > 0)) * queryTileSize) - ray.origin.x) / ray.direction.x : INFINITY;
+		double tNextZ = ray.direction.z != 0.0f ? ((double)((tileZ + (stepZ > 0)) * queryTileSize) - ray.origin.z) / ray.direction.z : INFINITY;
+
+		double tTileStart = tStart;
+		while (tTileStart <= tEnd)
+		{
+			double tTileEnd = std::min(std::min(tNextX, tNextZ), tEnd);
+			if (!tile || tile->x != tileX || tile->z != tileZ) tile = find(tileX, tileZ);
+
+			// Cast from where the ray enters the tile, relative to the tile's first lattice point, so the tile's part of
+			// the ray is solved in floats just as precisely wherever the tile is and however far the ray has come
+			glm::dvec3 entry = ray.origin + glm::dvec3(ray.direction) * tTileStart;
+			glm::vec3 origin((float)(entry.x - (double)(tileX * queryTileSize)), (float)entry.y, (float)(entry.z - (double)(tileZ * queryTileSize)));
+			float distance;
+			if (castTile(*tile, origin, ray.direction, (float)(tTileEnd - tTileStart), distance))
+			{
+				hit.hit = true;
+				hit.distance = (float)(tTileStart + distance);
+				hit.position = entry + glm::dvec3(ray.direction) * (double)distance;
+				hit.normal = surfaceNormal(*tile, origin.x + ray.direction.x * distance, origin.z + ray.direction.z * distance);
+				return hit;
+			}
+
+			if (tNextX < tNextZ)
+			{
+				tileX += stepX;
+				tNextX += tDeltaX;
+			}
+			else
+			{
+				tileZ += stepZ;
+				tNextZ += tDeltaZ;
+			}
+			tTileStart = tTileEnd;
+			if (tTileEnd >= tEnd) break;
+		}
+		return hit;
+	}
+
+	// Descends the pyramid of tile along the ray up to tEnd, front to back, true if it hits the surface
+	static bool castTile(const QueryTile &tile, const glm::vec3 &origin, const glm::vec3 &direction, float tEnd, float &distance)
+	{
+		struct Node
+		{
+			int level, i, j;
+		};
+		Node stack[4 * queryPyramidLevels];
+		int stackSize = 0;
+		stack[stackSize++] = { queryPyramidLevels - 1, 0, 0 };
+
+		// Children are pushed far first so the nearest is taken next, a line crossing a square never meets both of
+		// the two children between the nearest and farthest
+		int nearI = direction.x >= 0.0f ? 0 : 1;
+		int nearJ = direction.z >= 0.0f ? 0 : 1;
+		while (stackSize > 0)
+		{
+			Node node = stack[--stackSize];
+			float size = (float)(1 << node.level);
+			float t0, t1;
+			if (!slab(origin.x, direction.x, node.i * size, node.i * size + size, 0.0f, tEnd, t0, t1)) continue;
+			if (!slab(origin.z, direction.z, node.j * size, node.j * size + size, t0, t1, t0, t1)) continue;
+
+			int index = QueryTile::levelOffset(node.level) + node.i * (queryTileSize >> node.level) + node.j;
+			float y0 = origin.y + direction.y * t0;
+			float y1 = origin.y + direction.y * t1;
+			if (std::min(y0, y1) > tile.maximum[index]) continue;
+			if (y0 <= tile.minimum[index])
+			{
+				distance = t0;
+				return true;
+			}
+
+			if (node.level == 0)
+			{
+				if (castSquare(tile, node.i, node.j, origin, direction, t0, t1, distance)) return true;
+				continue;
+			}
+			for (int k = 3; k >= 0; k--)
+			{
+				// k = 0 is the near child, 3 the far one, 1 and 2 the others
+				int childI = k == 0 || k == 2 ? nearI : 1 - nearI;
+				int childJ = k == 0 || k == 1 ? nearJ : 1 - nearJ;
+				stack[stackSize++] = { node.level - 1, 2 * node.i + childI, 2 * node.j + childJ };
+			}
+		}
+		return false;
+	}
+
+	// Part of [tStart, tEnd] over which origin + t * direction lies between low and high along one axis
+	static bool slab(float origin, float direction, float low, float high, float tStart, float tEnd, float &t0, float &t1)
+	{
+		if (direction == 0.0f)
+		{
+			t0 = tStart;
+			t1 = tEnd;
+			return origin >= low && origin <= high;
+		}
+		float a = (low - origin) / direction;
+		float b = (high - origin) / direction;
+		t0 = std::max(tStart, std::min(a, b));
+		t1 = std::min(tEnd, std::max(a, b));
+		return t0 <= t1;
+	}
+
+	/*
+	First t in [t0, t1] at which the ray is on or below the bilinear surface of square (i, j). Along the ray the
+	surface's height is quadratic in t, so this is the first root of a quadratic if the ray starts above it.
+	*/
+	static bool castSquare(const QueryTile &tile, int i, int j, const glm::vec3 &origin, const glm::vec3 &direction, float t0, float t1, float &distance)
+	{
+		float h00 = tile.height(i, j), h10 = tile.height(i + 1, j), h01 = tile.height(i, j + 1), h11 = tile.height(i + 1, j + 1);
+		float slopeX = h10 - h00, slopeZ = h01 - h00, twist = h00 - h10 - h01 + h11;
+
+		// Height of the ray above the surface r along it from where it enters the square, as a * r^2 + b * r + c
+		float u = origin.x + direction.x * t0 - i, v = origin.z + direction.z * t0 - j;
+		float a = -twist * direction.x * direction.z;
+		float b = direction.y - (slopeX * direction.x + slopeZ * direction.z + twist * (u * direction.z + v * direction.x));
+		float c = origin.y + direction.y * t0 - (h00 + slopeX * u + slopeZ * v + twist * u * v);
+		if (c <= 0.0f)
+		{
+			distance = t0;
+			return true;
+		}
+
+		float roots[2];
+		int rootCount = 0;
+		if (std::fabs(a) < 1e-12f)
+		{
+			if (b != 0.0f) roots[rootCount++] = -c / b;
+		}
+		else
+		{
+			float discriminant = b * b - 4.0f * a * c;
+			if (discriminant < 0.0f) return false;
+			// Avoids cancellation between b and the square root
+			float q = -0.5f * (b + std::copysign(std::sqrt(discriminant), b));
+			roots[rootCount++] = q / a;
+			if (q != 0.0f) roots[rootCount++] = c / q;
+			if (rootCount == 2 && roots[1] < roots[0]) std::swap(roots[0], roots[1]);
+		}
+		for (int k = 0; k < rootCount; k++)
+		{
+			if (roots[k] >= 0.0f && roots[k] <= t1 - t0)
+			{
+				distance = t0 + roots[k];
+				return true;
+			}
+		}
+		return false;
+	}
+
+	const FractalNoise noise;
+	const size_t capacity;
+	const float lowest;
+	const float highest;
+
+	mutable std::shared_mutex mutex;
+	std::unordered_map<TileKey, std::shared_ptr<const QueryTile>, TileKeyHash> tiles;
+	std::vector<TileKey> order; // Keys in the order they were added, replaced from nextReplaced on
+	size_t nextReplaced = 0;
+	uint64_t generated = 0;
+};
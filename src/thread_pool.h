@@ -0,0 +1,233 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tasks each worker's queue has room for before it first grows
+const size_t initialTaskCapacity = 256;
+
+// Set of tasks submitted to a ThreadPool that acts as a completion fence
+class TaskGroup
+{
+public:
+	// True once every task submitted to the group has finished
+	bool done() const
+	{
+		return pending.load(std::memory_order_acquire) == 0;
+	}
+
+private:
+	friend class ThreadPool;
+
+	std::atomic<int> pending{ 0 };
+};
+
+/*
+Persistent pool of worker threads with work stealing.
+Every worker owns a queue of tasks. Workers take new work from the back of their own queue and, when it is empty,
+steal from the front of another worker's queue, so a worker that finishes its tiles early helps with the rest
+instead of sitting idle. Threads are created once and sleep while there is nothing to do.
+*/
+class ThreadPool
+{
+public:
+	// Creates threadCount workers, or one fewer than the number of hardware threads if threadCount is 0
+	explicit ThreadPool(unsigned int threadCount = 0)
+	{
+		if (threadCount == 0)
+		{
+			unsigned int hardwareThreads = std::thread::hardware_concurrency();
+			threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+		for (unsigned int i = 0; i < threadCount; i++) queues.emplace_back(new TaskQueue);
+		for (unsigned int i = 0; i < threadCount; i++) threads.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread &thread : threads) thread.join();
+	}
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	// Number of worker threads
+	unsigned int size() const
+	{
+		return (unsigned int)threads.size();
+	}
+
+	// Queues task as part of group, tasks are spread over the workers' queues in turn
+	void submit(TaskGroup &group, std::function<void()> task)
+	{
+		group.pending.fetch_add(1, std::memory_order_relaxed);
+
+		unsigned int index = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+		{
+			std::lock_guard<std::mutex> lock(queues[index]->mutex);
+			queues[index]->tasks.push_back({ std::move(task), &group });
+		}
+		queuedCount.fetch_add(1, std::memory_order_release);
+
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		wake.notify_one();
+	}
+
+	// Blocks until every task in group has finished, running queued tasks on the calling thread meanwhile
+	void wait(TaskGroup &group)
+	{
+		while (!group.done())
+		{
+			Task task;
+			if (stealTask(0, task)) run(task);
+			else std::this_thread::yield();
+		}
+	}
+
+private:
+	struct Task
+	{
+		std::function<void()> function;
+		TaskGroup *group;
+	};
+
+	/*
+	Double ended queue of tasks in a ring that doubles when full and never shrinks, so once it has grown to the most
+	tasks ever queued at once queueing never allocates
+	*/
+	class TaskRing
+	{
+	public:
+		TaskRing()
+			: tasks(initialTaskCapacity)
+		{
+		}
+
+		bool empty() const
+		{
+			return count == 0;
+		}
+
+		void push_back(Task &&task)
+		{
+			if (count == tasks.size()) grow();
+			tasks[(start + count) % tasks.size()] = std::move(task);
+			count++;
+		}
+
+		Task &back()
+		{
+			return tasks[(start + count - 1) % tasks.size()];
+		}
+
+		Task &front()
+		{
+			return tasks[start];
+		}
+
+		void pop_back()
+		{
+			count--;
+		}
+
+		void pop_front()
+		{
+			start = (start + 1) % tasks.size();
+			count--;
+		}
+
+	private:
+		void grow()
+		{
+			std::vector<Task> grown(2 * tasks.size());
+			for (size_t i = 0; i < count; i++) grown[i] = std::move(tasks[(start + i) % tasks.size()]);
+			tasks.swap(grown);
+			start = 0;
+		}
+
+		std::vector<Task> tasks;
+		size_t start = 0;
+		size_t count = 0;
+	};
+
+	struct TaskQueue
+	{
+		std::mutex mutex;
+		TaskRing tasks;
+	};
+
+	void run(Task &task)
+	{
+		task.function();
+		task.group->pending.fetch_sub(1, std::memory_order_acq_rel);
+	}
+
+	// Takes the most recently queued task from the worker's own queue
+	bool popTask(unsigned int index, Task &task)
+	{
+		TaskQueue &queue = *queues[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty()) return false;
+		task = std::move(queue.tasks.back());
+		queue.tasks.pop_back();
+		queuedCount.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Takes the oldest task from any queue, starting after the given one
+	bool stealTask(unsigned int start, Task &task)
+	{
+		for (size_t i = 0; i < queues.size(); i++)
+		{
+			TaskQueue &queue = *queues[(start + i) % queues.size()];
+			std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+			if (!lock.owns_lock() || queue.tasks.empty()) continue;
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			queuedCount.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+		return false;
+	}
+
+	void workerLoop(unsigned int index)
+	{
+		while (true)
+		{
+			Task task;
+			if (popTask(index, task) || stealTask(index + 1, task))
+			{
+				run(task);
+				continue;
+			}
+
+			// Sleeps until more work is queued
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			wake.wait(lock, [this] { return stopping || queuedCount.load(std::memory_order_acquire) > 0; });
+			if (stopping) return;
+		}
+	}
+
+	std::vector<std::unique_ptr<TaskQueue>> queues;
+	std::vector<std::thread> threads;
+	std::atomic<unsigned int> nextQueue{ 0 };
+
+	// Number of tasks sitting in any queue, used to decide whether a worker can go to sleep
+	std::atomic<int> queuedCount{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	bool stopping = false;
+};
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+Persistent cache of generated chunks backed by a memory mapped file.
+The file holds a header, a table of entries and a fixed number of equally sized slots. Each entry records which
+chunk (and which noise parameters, as a hash) its slot holds, so a chunk that was generated before, in this run or
+a previous one, can be handed to the GPU upload straight out of the mapping with no decoding or copying. Chunks
+are placed by hashing their key and probing a few neighbouring entries, replacing the first unreserved entry if
+they are all taken.
+*/
+
+const char tileCacheMagic[4] = { 'P', 'T', 'T', 'C' };
+const uint32_t tileCacheVersion = 2;
+
+// Number of neighbouring entries checked when looking a chunk up
+const uint32_t tileCacheProbeLength = 8;
+
+struct TileCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t slotCount;
+	uint32_t slotBytes;
+};
+
+enum TileCacheState : uint32_t
+{
+	tileCacheEmpty = 0,
+	tileCacheWriting = 1, // Reserved and being filled, never handed out or replaced
+	tileCacheValid = 2
+};
+
+struct TileCacheEntry
+{
+	int64_t x, z;
+	uint64_t noiseHash;
+	uint32_t state;
+	uint32_t reserved;
+};
+
+class TileCache
+{
+public:
+	~TileCache()
+	{
+		close();
+	}
+
+	// Maps the cache file at path, creating or resetting it if it doesn't match the requested layout
+	bool open(const std::string &path, uint32_t slotCount, uint32_t slotBytes)
+	{
+		close();
+
+		// Slots start on a page boundary so they can be paged in independently
+		size_t tableBytes = sizeof(TileCacheHeader) + (size_t)slotCount * sizeof(TileCacheEntry);
+		dataOffset = (tableBytes + 4095) & ~(size_t)4095;
+		fileBytes = dataOffset + (size_t)slotCount * slotBytes;
+
+		if (!mapFile(path)) return false;
+
+		TileCacheHeader *header = (TileCacheHeader *)mapping;
+		bool matches = std::memcmp(header->magic, tileCacheMagic, sizeof(header->magic)) == 0 && header->version == tileCacheVersion
+			&& header->slotCount == slotCount && header->slotBytes == slotBytes;
+		if (!matches)
+		{
+			std::memset(mapping, 0, tableBytes);
+			std::memcpy(header->magic, tileCacheMagic, sizeof(header->magic));
+			header->version = tileCacheVersion;
+			header->slotCount = slotCount;
+			header->slotBytes = slotBytes;
+		}
+
+		entries = (TileCacheEntry *)(mapping + sizeof(TileCacheHeader));
+		this->slotCount = slotCount;
+		this->slotBytes = slotBytes;
+
+		// Entries left half written by a previous run hold garbage
+		for (uint32_t i = 0; i < slotCount; i++)
+		{
+			if (entries[i].state == tileCacheWriting) entries[i].state = tileCacheEmpty;
+		}
+		return true;
+	}
+
+	bool isOpen() const
+	{
+		return mapping != NULL;
+	}
+
+	// Returns the cached data of chunk (x, z) generated with noiseHash, or NULL if it isn't cached
+	const void *find(int64_t x, int64_t z, uint64_t noiseHash) const
+	{
+		uint32_t home = homeEntry(x, z, noiseHash);
+		for (uint32_t i = 0; i < tileCacheProbeLength; i++)
+		{
+			uint32_t index = (home + i) % slotCount;
+			const TileCacheEntry &entry = entries[index];
+			if (entry.state == tileCacheValid && entry.x == x && entry.z == z && entry.noiseHash == noiseHash) return slotData(index);
+		}
+		return NULL;
+	}
+
+	/*
+	Reserves a slot for chunk (x, z) and returns its memory for the chunk to be generated straight into, or NULL if
+	every candidate slot is already reserved. The chunk can't be found until commit is called.
+	*/
+	void *reserve(int64_t x, int64_t z, uint64_t noiseHash)
+	{
+		uint32_t home = homeEntry(x, z, noiseHash);
+		uint32_t chosen = slotCount;
+		for (uint32_t i = 0; i < tileCacheProbeLength; i++)
+		{
+			uint32_t index = (home + i) % slotCount;
+			const TileCacheEntry &entry = entries[index];
+			bool sameChunk = entry.x == x && entry.z == z && entry.noiseHash == noiseHash;
+			if (entry.state == tileCacheWriting)
+			{
+				if (sameChunk) return NULL;
+				continue;
+			}
+
+			// Prefers overwriting an old copy of the same chunk, then an empty slot, then whatever comes first
+			if (sameChunk || entry.state == tileCacheEmpty)
+			{
+				chosen = index;
+				break;
+			}
+			if (chosen == slotCount) chosen = index;
+		}
+		if (chosen == slotCount) return NULL;
+
+		entries[chosen] = { x, z, noiseHash, tileCacheWriting, 0 };
+		return slotData(chosen);
+	}
+
+	// Marks the slot reserved for chunk (x, z) as holding valid data
+	void commit(int64_t x, int64_t z, uint64_t noiseHash)
+	{
+		setReservedState(x, z, noiseHash, tileCacheValid);
+	}
+
+	void close()
+	{
+		if (!mapping) return;
+#if defined(_WIN32)
+		UnmapViewOfFile(mapping);
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+#else
+		munmap(mapping, fileBytes);
+		::close(fileDescriptor);
+#endif
+		mapping = NULL;
+		entries = NULL;
+	}
+
+private:
+	bool mapFile(const std::string &path)
+	{
+#if defined(_WIN32)
+		fileHandle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (fileHandle == INVALID_HANDLE_VALUE) return false;
+		mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READWRITE, (DWORD)((uint64_t)fileBytes >> 32), (DWORD)fileBytes, NULL);
+		if (!mappingHandle)
+		{
+			CloseHandle(fileHandle);
+			return false;
+		}
+		mapping = (char *)MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, fileBytes);
+		if (!mapping)
+		{
+			CloseHandle(mappingHandle);
+			CloseHandle(fileHandle);
+			return false;
+		}
+#else
+		fileDescriptor = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		if (fileDescriptor < 0) return false;
+
+		// Growing the file fills it with zeros, which is an empty entry table
+		struct stat status;
+		if (fstat(fileDescriptor, &status) != 0 || ((size_t)status.st_size != fileBytes && ftruncate(fileDescriptor, fileBytes) != 0))
+		{
+			::close(fileDescriptor);
+			return false;
+		}
+
+		void *address = mmap(NULL, fileBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+		if (address == MAP_FAILED)
+		{
+			::close(fileDescriptor);
+			return false;
+		}
+		mapping = (char *)address;
+#endif
+		return true;
+	}
+
+	uint32_t homeEntry(int64_t x, int64_t z, uint64_t noiseHash) const
+	{
+		uint64_t key = ((uint64_t)x * 0x9E3779B97F4A7C15ull) ^ ((uint64_t)z * 0xC2B2AE3D27D4EB4Full) ^ noiseHash;
+		key ^= key >> 29;
+		return (uint32_t)(key % slotCount);
+	}
+
+	char *slotData(uint32_t index) const
+	{
+		return mapping + dataOffset + (size_t)index * slotBytes;
+	}
+
+	void setReservedState(int64_t x, int64_t z, uint64_t noiseHash, TileCacheState state)
+	{
+		uint32_t home = homeEntry(x, z, noiseHash);
+		for (uint32_t i = 0; i < tileCacheProbeLength; i++)
+		{
+			TileCacheEntry &entry = entries[(home + i) % slotCount];
+			if (entry.state == tileCacheWriting && entry.x == x && entry.z == z && entry.noiseHash == noiseHash)
+			{
+				entry.state = state;
+				return;
+			}
+		}
+	}
+
+	char *mapping = NULL;
+	TileCacheEntry *entries = NULL;
+	uint32_t slotCount = 0;
+	uint32_t slotBytes = 0;
+	size_t dataOffset = 0;
+	size_t fileBytes = 0;
+
+#if defined(_WIN32)
+	HANDLE fileHandle = INVALID_HANDLE_VALUE;
+	HANDLE mappingHandle = NULL;
+#else
+	int fileDescriptor = -1;
+#endif
+};
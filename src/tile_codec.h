@@ -0,0 +1,290 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(TILE_CODEC_ZSTD)
+#include <zstd.h>
+#endif
+
+/*
+Compact encoding of a tile of heights, for storing baked terrain and sending it to clients that would rather
+decode it than generate it.
+Each tile is quantised linearly between its own lowest and highest height to 12 or 16 bits, so flat tiles lose
+nothing to the range of the whole world. Each quantised height is then predicted from its neighbours before it
+along the row and in the row before (left + up - up left, exact for planes) and only the residual is kept. Terrain
+is smooth at the scale of its samples, so the residuals are small: each row stores them zigzag coded and bit packed
+at the width of its largest, usually a few bits per sample. Defining TILE_CODEC_ZSTD (and linking libzstd) also
+lets the packed rows be compressed with zstd.
+Decoding unpacks a row of residuals, sums them along the row into the differences from the row before, and adds
+those to the previous row. Only the running sum is serial, the other passes are plain loops over the row that the
+compiler vectorises, so decoding costs a few operations per sample against the hundreds of evaluating the noise.
+Heights can be decoded as floats or straight into 16 bit heights normalised over any range, with a stride, which
+is how Vertex in chunk_manager.h stores them.
+
+Layout of an encoded tile (little endian):
+	EncodedTileHeader
+	payloadBytes of packed rows, compressed if compression isn't tileUncompressed
+	each packed row is one byte giving the residuals' width in bits, then columns residuals of that width
+	packed from the lowest bit of each byte up and padded to a whole byte
+*/
+
+enum TileCompression : uint8_t
+{
+	tileUncompressed = 0,
+	tileZstd = 1
+};
+
+// zstd level tiles are compressed with, low as tiles are encoded while baking and the packing does most of the work
+const int tileZstdLevel = 3;
+
+struct EncodedTileHeader
+{
+	uint16_t rows, columns;
+	uint8_t bits; // Bits the heights are quantised to
+	uint8_t compression; // TileCompression of the payload
+	uint16_t reserved;
+	float minimum, maximum; // Range the heights are quantised over, the tile's lowest and highest height
+	uint32_t packedBytes; // Size of the packed rows before any compression
+	uint32_t payloadBytes; // Size of the data following the header
+};
+
+// Whether tiles can be compressed with compression in this build
+inline bool tileCompressionSupported(TileCompression compression)
+{
+#if defined(TILE_CODEC_ZSTD)
+	if (compression == tileZstd) return true;
+#endif
+	return compression == tileUncompressed;
+}
+
+// Bits needed to hold value
+inline int bitWidth(uint32_t value)
+{
+	int width = 0;
+	while (value)
+	{
+		width++;
+		value >>= 1;
+	}
+	return width;
+}
+
+/*
+Encodes a rows by columns tile of heights, ordered by row, quantised to bits (at most 16), and appends it to out.
+Falls back to no compression if compression isn't supported by this build.
+*/
+inline void encodeTile(const float *heights, int rows, int columns, int bits, TileCompression compression, std::vector<uint8_t> &out)
+{
+	const size_t count = (size_t)rows * columns;
+	float minimum = heights[0];
+	float maximum = heights[0];
+	for (size_t i = 1; i < count; i++)
+	{
+		minimum = std::min(minimum, heights[i]);
+		maximum = std::max(maximum, heights[i]);
+	}
+	const int32_t levels = (1 << bits) - 1;
+	const float scale = maximum > minimum ? levels / (maximum - minimum) : 0.0f;
+
+	// The row before the first is taken to be all zero, which predicts each height of the first row from the one before it
+	std::vector<int32_t> previous(columns, 0);
+	std::vector<int32_t> current(columns);
+	std::vector<uint32_t> residuals(columns);
+	std::vector<uint8_t> packed;
+	packed.reserve(count * bits / 8 + rows);
+	for (int i = 0; i < rows; i++)
+	{
+		for (int j = 0; j < columns; j++)
+		{
+			int32_t quantised = (int32_t)((heights[(size_t)i * columns + j] - minimum) * scale + 0.5f);
+			current[j] = std::min(std::max(quantised, 0), levels);
+		}
+
+		uint32_t largest = 0;
+		for (int j = 0; j < columns; j++)
+		{
+			int32_t predicted = j == 0 ? previous[0] : current[j - 1] + previous[j] - previous[j - 1];
+			int32_t residual = current[j] - predicted;
+			residuals[j] = ((uint32_t)residual << 1) ^ (uint32_t)(residual >> 31);
+			largest = std::max(largest, residuals[j]);
+		}
+
+		int width = bitWidth(largest);
+		packed.push_back((uint8_t)width);
+		uint64_t buffer = 0;
+		int used = 0;
+		for (int j = 0; j < columns; j++)
+		{
+			buffer |= (uint64_t)residuals[j] << used;
+			used += width;
+			while (used >= 8)
+			{
+				packed.push_back((uint8_t)buffer);
+				buffer >>= 8;
+				used -= 8;
+			}
+		}
+		if (used > 0) packed.push_back((uint8_t)buffer);
+		previous.swap(current);
+	}
+
+	EncodedTileHeader header;
+	header.rows = (uint16_t)rows;
+	header.columns = (uint16_t)columns;
+	header.bits = (uint8_t)bits;
+	header.compression = tileUncompressed;
+	header.reserved = 0;
+	header.minimum = minimum;
+	header.maximum = maximum;
+	header.packedBytes = (uint32_t)packed.size();
+	header.payloadBytes = (uint32_t)packed.size();
+
+	size_t start = out.size();
+	out.resize(start + sizeof(header) + packed.size());
+#if defined(TILE_CODEC_ZSTD)
+	if (compression == tileZstd)
+	{
+		std::vector<uint8_t> compressed(ZSTD_compressBound(packed.size()));
+		size_t compressedBytes = ZSTD_compress(compressed.data(), compressed.size(), packed.data(), packed.size(), tileZstdLevel);
+		if (!ZSTD_isError(compressedBytes) && compressedBytes < packed.size())
+		{
+			header.compression = tileZstd;
+			header.payloadBytes = (uint32_t)compressedBytes;
+			packed.assign(compressed.begin(), compressed.begin() + compressedBytes);
+			out.resize(start + sizeof(header) + packed.size());
+		}
+	}
+#else
+	(void)compression;
+#endif
+	std::memcpy(&out[start], &header, sizeof(header));
+	std::memcpy(&out[start + sizeof(header)], packed.data(), packed.size());
+}
+
+// Reads the header of an encoded tile of bytes, false if it is malformed or truncated
+inline bool readTileHeader(const uint8_t *data, size_t bytes, EncodedTileHeader &header)
+{
+	if (bytes < sizeof(header)) return false;
+	std::memcpy(&header, data, sizeof(header));
+	if (header.rows == 0 || header.columns == 0 || header.bits == 0 || header.bits > 16) return false;
+	if (!tileCompressionSupported((TileCompression)header.compression)) return false;
+	return header.payloadBytes <= bytes - sizeof(header);
+}
+
+/*
+Decodes encoded tiles, keeping the scratch rows between tiles so decoding doesn't allocate once it has seen a tile
+of the largest size. Each decoder is only used by one thread at a time.
+*/
+class TileDecoder
+{
+public:
+	// Decodes the tile in data into rows * columns floats, false if the tile is malformed
+	bool decodeHeights(const uint8_t *data, size_t bytes, float *out)
+	{
+		EncodedTileHeader header;
+		if (!readTileHeader(data, bytes, header)) return false;
+		const float step = (header.maximum - header.minimum) / ((1 << header.bits) - 1);
+		const float minimum = header.minimum;
+		const int columns = header.columns;
+		return decodeRows(data, header, [out, step, minimum, columns](int i, const int32_t *quantised)
+		{
+			float *row = out + (size_t)i * columns;
+			for (int j = 0; j < columns; j++) row[j] = minimum + quantised[j] * step;
+		});
+	}
+
+	/*
+	Decodes the tile in data into 16 bit heights normalised from rangeMinimum to rangeMinimum + rangeSize, height
+	(i, j) going to out[(i * columns + j) * stride], false if the tile is malformed. A stride of
+	sizeof(Vertex) / sizeof(uint16_t) writes straight into the height of chunk vertices.
+	*/
+	bool decodeNormalised(const uint8_t *data, size_t bytes, float rangeMinimum, float rangeSize, uint16_t *out, size_t stride)
+	{
+		EncodedTileHeader header;
+		if (!readTileHeader(data, bytes, header)) return false;
+
+		// Normalising is linear in the quantised height so is a multiply and add per height
+		const float step = (header.maximum - header.minimum) / ((1 << header.bits) - 1);
+		const float scale = step * 65535.0f / rangeSize;
+		const float offset = (header.minimum - rangeMinimum) * 65535.0f / rangeSize + 0.5f;
+		const int columns = header.columns;
+		return decodeRows(data, header, [out, stride, scale, offset, columns](int i, const int32_t *quantised)
+		{
+			uint16_t *row = out + (size_t)i * columns * stride;
+			for (int j = 0; j < columns; j++)
+			{
+				float value = std::min(std::max(quantised[j] * scale + offset, 0.0f), 65535.0f);
+				row[j * stride] = (uint16_t)value;
+			}
+		});
+	}
+
+private:
+	// Decodes each row of quantised heights of the tile in data and passes it to output with its index
+	template <typename Output>
+	bool decodeRows(const uint8_t *data, const EncodedTileHeader &header, Output output)
+	{
+		const uint8_t *packed = data + sizeof(header);
+		if (header.compression == tileZstd)
+		{
+#if defined(TILE_CODEC_ZSTD)
+			decompressed.resize(header.packedBytes);
+			size_t decompressedBytes = ZSTD_decompress(decompressed.data(), decompressed.size(), packed, header.payloadBytes);
+			if (ZSTD_isError(decompressedBytes) || decompressedBytes != header.packedBytes) return false;
+			packed = decompressed.data();
+#else
+			return false;
+#endif
+		}
+		else if (header.packedBytes != header.payloadBytes)
+		{
+			return false;
+		}
+		const uint8_t *end = packed + header.packedBytes;
+
+		const int columns = header.columns;
+		previous.assign(columns, 0);
+		differences.resize(columns);
+		current.resize(columns);
+		for (int i = 0; i < header.rows; i++)
+		{
+			if (packed >= end) return false;
+			int width = *packed++;
+			if (width > 32 || ((size_t)columns * width + 7) / 8 > (size_t)(end - packed)) return false;
+
+			// The prediction's residuals sum along the row to the difference from the row above
+			uint64_t buffer = 0;
+			int available = 0;
+			const uint64_t mask = width == 32 ? 0xFFFFFFFFull : (1ull << width) - 1;
+			int32_t difference = 0;
+			for (int j = 0; j < columns; j++)
+			{
+				while (available < width)
+				{
+					buffer |= (uint64_t)*packed++ << available;
+					available += 8;
+				}
+				uint32_t zigzag = (uint32_t)(buffer & mask);
+				buffer >>= width;
+				available -= width;
+				difference += (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+				differences[j] = difference;
+			}
+
+			for (int j = 0; j < columns; j++) current[j] = previous[j] + differences[j];
+			output(i, current.data());
+			previous.swap(current);
+		}
+		return true;
+	}
+
+	std::vector<int32_t> previous;
+	std::vector<int32_t> current;
+	std::vector<int32_t> differences;
+	std::vector<uint8_t> decompressed;
+};
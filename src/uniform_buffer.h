@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <glad/glad.h>
+
+/*
+Uniform buffer object holding a std140 uniform block laid out as Block, shared by every program the block is
+attached to. Changes are made to a copy on the CPU and commit only uploads it when it differs from what was last
+uploaded, so data that is the same from frame to frame, like the projection while the camera is still, costs no
+driver calls at all. Block must have no padding the compiler fills in, which holds for structs of vec4, ivec4 and
+mat4 members.
+*/
+template <typename Block>
+class UniformBuffer
+{
+public:
+	~UniformBuffer()
+	{
+		if (buffer) glDeleteBuffers(1, &buffer);
+	}
+
+	// Creates the buffer and binds it to binding, the binding point every program it is attached to reads it from
+	void initialise(unsigned int binding)
+	{
+		this->binding = binding;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), NULL, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+	}
+
+	// Points the block called name in program at the buffer, done once after linking, false if program has no such block
+	bool attach(unsigned int program, const char *name) const
+	{
+		unsigned int index = glGetUniformBlockIndex(program, name);
+		if (index == GL_INVALID_INDEX) return false;
+		glUniformBlockBinding(program, index, binding);
+		return true;
+	}
+
+	// Copy of the block to change, only uploaded by commit
+	Block &data()
+	{
+		return block;
+	}
+
+	// Uploads the block if it has changed since the last upload, returns whether it did
+	bool commit()
+	{
+		if (uploaded && std::memcmp(&block, &last, sizeof(Block)) == 0) return false;
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+		last = block;
+		uploaded = true;
+		uploads++;
+		return true;
+	}
+
+	// Number of times commit has uploaded the block
+	uint64_t uploadCount() const
+	{
+		return uploads;
+	}
+
+private:
+	Block block = {};
+	Block last = {};
+	bool uploaded = false;
+	uint64_t uploads = 0;
+	unsigned int buffer = 0;
+	unsigned int binding = 0;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// Width in world units of the cells a WorldPosition is split into
+const int worldCellSize = 64;
+
+// Integer division rounding towards negative infinity, b must be positive
+inline int64_t floorDivide(int64_t a, int64_t b)
+{
+	int64_t quotient = a / b;
+	return quotient - (a % b < 0 ? 1 : 0);
+}
+
+/*
+Position in a world too large for float coordinates.
+The xz plane is split into square cells indexed by 64 bit integers and the position is a float offset into its
+cell, so it is as precise a million units from the origin as at it. Anything drawn or culled is placed relative to
+the camera with relativeX and relativeZ, which keeps every float given to the GPU small.
+*/
+struct WorldPosition
+{
+	int64_t cellX = 0;
+	int64_t cellZ = 0;
+	glm::vec3 local = glm::vec3(0.0f); // x and z lie between 0 and worldCellSize, y is the height
+
+	static WorldPosition fromWorld(double x, double y, double z)
+	{
+		WorldPosition position;
+		position.cellX = (int64_t)std::floor(x / worldCellSize);
+		position.cellZ = (int64_t)std::floor(z / worldCellSize);
+		position.local.x = (float)(x - (double)position.cellX * worldCellSize);
+		position.local.y = (float)y;
+		position.local.z = (float)(z - (double)position.cellZ * worldCellSize);
+		position.normalise();
+		return position;
+	}
+
+	// Moves by offset, whole cells are carried over from the local offset
+	WorldPosition &operator+=(const glm::vec3 &offset)
+	{
+		local += offset;
+		normalise();
+		return *this;
+	}
+
+	// Moves whole cells out of the local offset so it stays within its cell
+	void normalise()
+	{
+		float cellsX = std::floor(local.x / worldCellSize);
+		float cellsZ = std::floor(local.z / worldCellSize);
+		cellX += (int64_t)cellsX;
+		cellZ += (int64_t)cellsZ;
+		local.x -= cellsX * worldCellSize;
+		local.z -= cellsZ * worldCellSize;
+	}
+
+	// Offset from the position to other, for positions close enough together for a float offset
+	glm::vec3 offsetTo(const WorldPosition &other) const
+	{
+		glm::vec3 cells((float)((other.cellX - cellX) * worldCellSize), 0.0f, (float)((other.cellZ - cellZ) * worldCellSize));
+		return cells + other.local - local;
+	}
+
+	// Coordinates as doubles, for when an approximate absolute position is needed
+	double worldX() const
+	{
+		return (double)cellX * worldCellSize + local.x;
+	}
+
+	double worldZ() const
+	{
+		return (double)cellZ * worldCellSize + local.z;
+	}
+
+	// Integer world coordinates of the lattice point at or below the position
+	int64_t floorX() const
+	{
+		return cellX * worldCellSize + (int64_t)std::floor(local.x);
+	}
+
+	int64_t floorZ() const
+	{
+		return cellZ * worldCellSize + (int64_t)std::floor(local.z);
+	}
+
+	// Offset from the position to integer world coordinate x or z, exact for points within 2^24 units
+	float relativeX(int64_t x) const
+	{
+		return (float)(x - cellX * worldCellSize) - local.x;
+	}
+
+	float relativeZ(int64_t z) const
+	{
+		return (float)(z - cellZ * worldCellSize) - local.z;
+	}
+};